@@ -27,15 +27,62 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "../base/streamingBuffer.hpp"
+#include "../base/spirvReflect.hpp"
+#include "../base/spirvStrip.hpp"
+
 const std::string appTitle = "OpenGL example - GL_ARB_gl_spirv";
 
-struct 
+struct UBOVS
 {
 	glm::mat4 projection;
 	glm::mat4 model;
 	glm::mat4 view;
 } uboVS;
 
+// Reads and reflects a SPIR-V module, no GL context required
+bool reflectShader(const char *fileName, std::vector<uint32_t> &code, SpirvReflection &reflection)
+{
+	std::ifstream shaderFile(fileName, std::ios::binary | std::ios::ate);
+	if (!shaderFile.is_open())
+	{
+		std::cerr << "Could not open \"" << fileName << "\"" << std::endl;
+		return false;
+	}
+	size_t size = shaderFile.tellg();
+	shaderFile.seekg(0, std::ios::beg);
+	code.resize(size / sizeof(uint32_t));
+	shaderFile.read((char*)code.data(), code.size() * sizeof(uint32_t));
+	if (!reflection.parse(code))
+	{
+		std::cerr << "\"" << fileName << "\": " << reflection.getError() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks the host side uboVS against the uniform block declared in the vertex shader
+bool validateUBOLayout(const SpirvReflection &reflection)
+{
+	const SpirvReflection::Block *block = reflection.findBlock("UBO");
+	if (!block)
+	{
+		std::cerr << "Vertex shader has no uniform block \"UBO\"" << std::endl;
+		return false;
+	}
+	std::vector<SpirvHostMember> hostMembers = {
+		SPIRV_HOST_MEMBER(UBOVS, projection),
+		SPIRV_HOST_MEMBER(UBOVS, model),
+		SPIRV_HOST_MEMBER(UBOVS, view),
+	};
+	if (!reflection.validateBlock(*block, sizeof(UBOVS), hostMembers))
+	{
+		std::cerr << "uboVS doesn't match the shader, expected layout:" << std::endl << reflection.generateStruct(*block);
+		return false;
+	}
+	return true;
+}
+
 class OpenGLExample
 {
 public:
@@ -43,6 +90,14 @@ public:
 	GLuint VBO[2];
 	GLuint IBO;
 	GLuint UBO;
+	// Taken from the shader's reflection instead of being hard coded
+	GLuint uboBinding = 0;
+	SpirvReflection vertexReflection;
+	SpirvReflection fragmentReflection;
+	// Strip modules after reflecting them and before passing them to the driver (--strip-on-load)
+	bool stripShaders = false;
+	// Persistently mapped ring buffer for the ubo, if buffer storage is supported
+	StreamingBuffer uniformStream;
 	uint32_t indices;
 	float zoom = -2.0f;
 	glm::vec3 rotation = glm::vec3(0.0f);
@@ -83,29 +138,29 @@ public:
 		};
 	}
 
-	bool loadBinaryShader(const char *fileName, GLuint stage, GLuint binaryFormat, GLuint &shader)
+	bool loadBinaryShader(const char *fileName, GLuint stage, GLuint binaryFormat, GLuint &shader, SpirvReflection &reflection)
 	{
-		std::ifstream shaderFile;
-		shaderFile.open(fileName, std::ios::binary | std::ios::ate);
-		if (shaderFile.is_open())
+		std::vector<uint32_t> code;
+		if (!reflectShader(fileName, code, reflection) || reflection.entryPoints.empty())
 		{
-			size_t size = shaderFile.tellg();
-			shaderFile.seekg(0, std::ios::beg);
-			char* bin = new char[size];
-			shaderFile.read(bin, size);
-
-			GLint status;
-			shader = glCreateShader(stage);									// Create a new shader
-			glShaderBinary(1, &shader, binaryFormat, bin, size);			// Load the binary shader file
-			glSpecializeShaderARB(shader, "main", 0, nullptr, nullptr);		// Set main entry point (required, no specialization used in this example)
-			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);				// Check compilation status
-			return status;
+			return false;
 		}
-		else
+
+		if (stripShaders)
 		{
-			std::cerr << "Could not open \"" << fileName << "\"" << std::endl;
-			return false;
+			SpirvStripper::Stats stats;
+			SpirvStripper::strip(code, SPIRV_STRIP_ALL, &stats);
+			SpirvStripper::printStats(fileName, stats);
 		}
+
+		double loadStart = glfwGetTime();
+		GLint status;
+		shader = glCreateShader(stage);																		// Create a new shader
+		glShaderBinary(1, &shader, binaryFormat, code.data(), (GLsizei)(code.size() * sizeof(uint32_t)));	// Load the binary shader file
+		glSpecializeShaderARB(shader, reflection.entryPoints[0].name.c_str(), 0, nullptr, nullptr);			// Set entry point (required, no specialization used in this example)
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);													// Check compilation status
+		std::cout << "Loaded \"" << fileName << "\" (" << code.size() * sizeof(uint32_t) << " bytes) in " << (glfwGetTime() - loadStart) * 1000.0 << " ms" << std::endl;
+		return status;
 	}
 
 	GLuint loadShader(const char* vsFileName, const char* fsFileName)
@@ -114,8 +169,8 @@ public:
 
 		GLint result = GL_TRUE;
 
-		result &= loadBinaryShader(vsFileName, GL_VERTEX_SHADER, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, vertShader);
-		result &= loadBinaryShader(fsFileName, GL_FRAGMENT_SHADER, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, fragShader);
+		result &= loadBinaryShader(vsFileName, GL_VERTEX_SHADER, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, vertShader, vertexReflection);
+		result &= loadBinaryShader(fsFileName, GL_FRAGMENT_SHADER, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, fragShader, fragmentReflection);
 
 		if (!result)
 		{
@@ -123,6 +178,17 @@ public:
 			return GL_FALSE;
 		}
 
+		// SPIR-V modules don't need to keep names, so the ubo binding and layout come from the CPU side reflection
+		if (!validateUBOLayout(vertexReflection))
+		{
+			return GL_FALSE;
+		}
+		uboBinding = vertexReflection.findBlock("UBO")->binding;
+		if ((vertexReflection.getInputLocation("inPos") != 0) || (vertexReflection.getInputLocation("inColor") != 1))
+		{
+			std::cerr << "Vertex shader input locations don't match the vertex buffer setup" << std::endl;
+		}
+
 		std::cout << "Linking shader program" << std::endl;
 		GLuint program = glCreateProgram();
 		glAttachShader(program, vertShader);
@@ -138,7 +204,11 @@ public:
 		glDeleteShader(vertShader);
 		glDeleteShader(fragShader);
 
-		glBindBufferBase(GL_UNIFORM_BUFFER, 0, UBO);
+		// The streaming buffer binds a range on each update instead
+		if (!uniformStream.isCreated())
+		{
+			glBindBufferBase(GL_UNIFORM_BUFFER, uboBinding, UBO);
+		}
 
 		glUseProgram(program);
 
@@ -163,6 +233,15 @@ public:
 		uboVS.model = glm::rotate(uboVS.model, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
 		uboVS.model = glm::rotate(uboVS.model, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
+		if (uniformStream.isCreated())
+		{
+			// Write into this frame's region of the persistently mapped buffer, no sync with the gpu required
+			StreamingBuffer::Allocation allocation = uniformStream.allocate(sizeof(uboVS));
+			memcpy(allocation.pointer, &uboVS, sizeof(uboVS));
+			uniformStream.bindRange(uboBinding, allocation);
+			return;
+		}
+
 		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
 		GLvoid* p = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
 		memcpy(p, &uboVS, sizeof(uboVS));
@@ -214,10 +293,19 @@ public:
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, iBufferSize, indexBuffer.data(), GL_STATIC_DRAW);
 
 		// Uniform buffer object
-		glGenBuffers(1, &UBO);
-		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(uboVS), &uboVS, GL_DYNAMIC_DRAW);
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		if (StreamingBuffer::isSupported())
+		{
+			// Ring buffer with one region per frame in flight, each region can hold several ubo updates
+			uniformStream.create(GL_UNIFORM_BUFFER, 4 * sizeof(uboVS), 3);
+			UBO = uniformStream.getBuffer();
+		}
+		else
+		{
+			glGenBuffers(1, &UBO);
+			glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(uboVS), &uboVS, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
 
 		updateUBO();
 
@@ -236,6 +324,12 @@ public:
 
 		glfwSwapBuffers(window);
 
+		// All commands reading this frame's uniforms have been submitted
+		if (uniformStream.isCreated())
+		{
+			uniformStream.nextFrame();
+		}
+
 		rotation.y += deltaT * 50.0f;
 		updateUBO();
 	}
@@ -258,8 +352,85 @@ static void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	glViewport(0, 0, width, height);
 }
 
-int main(void)
+// Offline validation of the shaders without creating a window or context:
+// SPIRVShader --validate [vertex shader] [fragment shader]
+int validateShaders(int argc, char *argv[])
+{
+	const char *vsFileName = (argc > 2) ? argv[2] : "../data/shader/triangle.vert.spv";
+	const char *fsFileName = (argc > 3) ? argv[3] : "../data/shader/triangle.frag.spv";
+	std::vector<uint32_t> vsCode, fsCode;
+	SpirvReflection vsReflection, fsReflection;
+	if (!reflectShader(vsFileName, vsCode, vsReflection) || !reflectShader(fsFileName, fsCode, fsReflection))
+	{
+		return EXIT_FAILURE;
+	}
+	std::cout << vsFileName << " (" << vsCode.size() * sizeof(uint32_t) << " bytes)" << std::endl;
+	vsReflection.printReport();
+	std::cout << fsFileName << " (" << fsCode.size() * sizeof(uint32_t) << " bytes)" << std::endl;
+	fsReflection.printReport();
+
+	bool valid = validateUBOLayout(vsReflection);
+	// Vertex outputs have to be consumed by fragment inputs at the same location
+	for (auto& input : fsReflection.inputs)
+	{
+		bool matched = false;
+		for (auto& output : vsReflection.outputs)
+		{
+			matched |= (output.location == input.location) && (output.typeName == input.typeName);
+		}
+		if (!matched)
+		{
+			std::cerr << "Fragment input \"" << input.name << "\" (location " << input.location << ") has no matching vertex output" << std::endl;
+			valid = false;
+		}
+	}
+	std::cout << (valid ? "Validation passed" : "Validation failed") << std::endl;
+	return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Offline stripping of a module:
+// SPIRVShader --strip input.spv output.spv
+int stripShader(int argc, char *argv[])
 {
+	if (argc < 4)
+	{
+		std::cerr << "Usage: SPIRVShader --strip input.spv output.spv" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<uint32_t> code;
+	SpirvReflection reflection;
+	if (!reflectShader(argv[2], code, reflection))
+	{
+		return EXIT_FAILURE;
+	}
+	SpirvStripper::Stats stats;
+	if (!SpirvStripper::strip(code, SPIRV_STRIP_ALL, &stats))
+	{
+		std::cerr << "\"" << argv[2] << "\" could not be stripped" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::ofstream outputFile(argv[3], std::ios::binary);
+	if (!outputFile.is_open())
+	{
+		std::cerr << "Could not open \"" << argv[3] << "\"" << std::endl;
+		return EXIT_FAILURE;
+	}
+	outputFile.write((const char*)code.data(), code.size() * sizeof(uint32_t));
+	SpirvStripper::printStats(argv[2], stats);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	if ((argc > 1) && (std::string(argv[1]) == "--validate"))
+	{
+		return validateShaders(argc, argv);
+	}
+	if ((argc > 1) && (std::string(argv[1]) == "--strip"))
+	{
+		return stripShader(argc, argv);
+	}
+
 	glfwSetErrorCallback(error_callback);
 
 	if (!glfwInit())
@@ -311,6 +482,7 @@ int main(void)
 	glfwSwapInterval(0);
 
 	OpenGLExample example(window);
+	example.stripShaders = (argc > 1) && (std::string(argv[1]) == "--strip-on-load");
 
 	example.generateBuffers();
 	example.loadAssets();
@@ -333,7 +505,9 @@ int main(void)
 
 			std::string windowTitle = appTitle +" (";
 			windowTitle += std::to_string(frameCounter);
-			windowTitle += " fps) - 2016 by Sascha Willems (www.saschawillems.de)";
+			windowTitle += " fps, ";
+			windowTitle += std::to_string(example.uniformStream.stats.fenceWaits);
+			windowTitle += " ubo fence waits) - 2016 by Sascha Willems (www.saschawillems.de)";
 			const char* windowCaption = windowTitle.c_str();
 			glfwSetWindowTitle(window, windowCaption);
 
@@ -351,6 +525,9 @@ int main(void)
 	} //Check if the ESC key had been pressed or if the window had been closed
 	while (!glfwWindowShouldClose(window));
 
+	// Unmap the persistently mapped ubo ring buffer and release its fences while the context is still current
+	example.uniformStream.destroy();
+
 	//Close OpenGL window and terminate GLFW
 	glfwDestroyWindow(window);
 	//Finalize and clean up GLFW
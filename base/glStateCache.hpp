@@ -0,0 +1,361 @@
+/*
+* Thin OpenGL state cache that filters redundant state changes and counts calls per entry point
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+// Entry points tracked by the state cache
+#define STATE_CALL_USE_PROGRAM 0
+#define STATE_CALL_BIND_BUFFER 1
+#define STATE_CALL_BIND_BUFFER_BASE 2
+#define STATE_CALL_BIND_VERTEX_ARRAY 3
+#define STATE_CALL_ACTIVE_TEXTURE 4
+#define STATE_CALL_BIND_TEXTURE 5
+#define STATE_CALL_ENABLE 6
+#define STATE_CALL_DISABLE 7
+#define STATE_CALL_BLEND_FUNC 8
+#define STATE_CALL_ENABLE_VERTEX_ATTRIB_ARRAY 9
+#define STATE_CALL_GET_UNIFORM_LOCATION 10
+#define STATE_CALL_GET_ATTRIB_LOCATION 11
+#define STATE_CALL_COUNT 12
+
+#define STATE_CACHE_MAX_TEXTURE_UNITS 16
+#define STATE_CACHE_MAX_BUFFER_INDICES 16
+#define STATE_CACHE_MAX_VERTEX_ATTRIBS 16
+
+// Shadows bound programs, buffers, vertex arrays, textures and enable bits
+// Calls that wouldn't change the current state are not passed on to the driver
+// Code that changes GL state directly (bypassing the cache) has to call invalidate() afterwards,
+// or invalidateBuffer() if it only changed a single buffer binding
+class GLStateCache
+{
+private:
+	// Marks shadowed state that is not known and has to be set on the next call
+	static const GLuint unknown = 0xFFFFFFFF;
+
+	// Buffer targets with a shadowed binding
+	static int32_t bufferSlot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_ELEMENT_ARRAY_BUFFER: return 1;
+		case GL_UNIFORM_BUFFER: return 2;
+		case GL_SHADER_STORAGE_BUFFER: return 3;
+		case GL_DRAW_INDIRECT_BUFFER: return 4;
+		case GL_DISPATCH_INDIRECT_BUFFER: return 5;
+		case GL_COPY_READ_BUFFER: return 6;
+		case GL_COPY_WRITE_BUFFER: return 7;
+		default: return -1;
+		}
+	}
+
+	// Texture targets with a shadowed binding
+	static int32_t textureSlot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_3D: return 1;
+		case GL_TEXTURE_CUBE_MAP: return 2;
+		case GL_TEXTURE_2D_ARRAY: return 3;
+		default: return -1;
+		}
+	}
+
+	GLuint program;
+	GLuint vertexArray;
+	GLuint buffers[8];
+	// Indexed bindings for uniform (0) and shader storage (1) buffers
+	GLuint indexedBuffers[2][STATE_CACHE_MAX_BUFFER_INDICES];
+	GLuint activeTextureUnit;
+	GLuint textures[STATE_CACHE_MAX_TEXTURE_UNITS][4];
+	GLenum blendSrc, blendDst;
+	// Vertex attribute enables are part of the vertex array state
+	uint8_t vertexAttribEnabled[STATE_CACHE_MAX_VERTEX_ATTRIBS];
+	// 0 = disabled, 1 = enabled, anything not in the map is unknown
+	std::unordered_map<GLenum, uint8_t> capabilities;
+	// Locations are only valid for the lifetime of a program, see invalidateProgram()
+	std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> uniformLocations;
+	std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> attribLocations;
+
+	// Counts the call and returns true if it has to be passed on to the driver
+	bool filter(uint32_t call, bool redundant)
+	{
+		frame.total[call]++;
+		if (redundant)
+		{
+			frame.filtered[call]++;
+			return false;
+		}
+		frame.issued[call]++;
+		return true;
+	}
+
+	void invalidateVertexArrayState()
+	{
+		buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+		std::fill(vertexAttribEnabled, vertexAttribEnabled + STATE_CACHE_MAX_VERTEX_ATTRIBS, 0xFF);
+	}
+
+public:
+	struct CallStats
+	{
+		uint32_t total[STATE_CALL_COUNT];
+		uint32_t filtered[STATE_CALL_COUNT];
+		uint32_t issued[STATE_CALL_COUNT];
+	};
+	// Counters of the frame currently being recorded and of the last completed frame
+	CallStats frame = {};
+	CallStats lastFrame = {};
+
+	GLStateCache()
+	{
+		invalidate();
+	}
+
+	static const char* getCallName(uint32_t call)
+	{
+		static const char* names[STATE_CALL_COUNT] = {
+			"glUseProgram", "glBindBuffer", "glBindBufferBase", "glBindVertexArray",
+			"glActiveTexture", "glBindTexture", "glEnable", "glDisable", "glBlendFunc",
+			"glEnableVertexAttribArray", "glGetUniformLocation", "glGetAttribLocation"
+		};
+		return names[call];
+	}
+
+	// Forget all shadowed state, the next call for each state will be passed on
+	void invalidate()
+	{
+		program = unknown;
+		vertexArray = unknown;
+		std::fill(buffers, buffers + 8, unknown);
+		std::fill(&indexedBuffers[0][0], &indexedBuffers[0][0] + 2 * STATE_CACHE_MAX_BUFFER_INDICES, unknown);
+		activeTextureUnit = unknown;
+		std::fill(&textures[0][0], &textures[0][0] + STATE_CACHE_MAX_TEXTURE_UNITS * 4, unknown);
+		blendSrc = blendDst = unknown;
+		capabilities.clear();
+		invalidateVertexArrayState();
+	}
+
+	// Drops cached locations, call when a program is deleted or relinked
+	void invalidateProgram(GLuint program)
+	{
+		uniformLocations.erase(program);
+		attribLocations.erase(program);
+		if (this->program == program)
+		{
+			this->program = unknown;
+		}
+	}
+
+	// Forgets the generic binding of a single buffer target, for helpers that bind buffers themselves (e.g. StreamingBuffer)
+	void invalidateBuffer(GLenum target)
+	{
+		int32_t slot = bufferSlot(target);
+		if (slot >= 0)
+		{
+			buffers[slot] = unknown;
+		}
+	}
+
+	// Deleted buffers are unbound from all (generic and indexed) binding points of the context
+	void deleteBuffers(GLsizei count, const GLuint* names)
+	{
+		glDeleteBuffers(count, names);
+		for (GLsizei i = 0; i < count; i++)
+		{
+			if (names[i] == 0)
+			{
+				continue;
+			}
+			std::replace(buffers, buffers + 8, names[i], 0u);
+			std::replace(&indexedBuffers[0][0], &indexedBuffers[0][0] + 2 * STATE_CACHE_MAX_BUFFER_INDICES, names[i], 0u);
+		}
+	}
+
+	// Moves the current counters to lastFrame and starts a new frame
+	void endFrame()
+	{
+		lastFrame = frame;
+		frame = CallStats();
+	}
+
+	void useProgram(GLuint program)
+	{
+		if (filter(STATE_CALL_USE_PROGRAM, this->program == program))
+		{
+			glUseProgram(program);
+			this->program = program;
+		}
+	}
+
+	void bindBuffer(GLenum target, GLuint buffer)
+	{
+		int32_t slot = bufferSlot(target);
+		if (filter(STATE_CALL_BIND_BUFFER, (slot >= 0) && (buffers[slot] == buffer)))
+		{
+			glBindBuffer(target, buffer);
+			if (slot >= 0)
+			{
+				buffers[slot] = buffer;
+			}
+		}
+	}
+
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		int32_t indexed = (target == GL_UNIFORM_BUFFER) ? 0 : (target == GL_SHADER_STORAGE_BUFFER) ? 1 : -1;
+		bool known = (indexed >= 0) && (index < STATE_CACHE_MAX_BUFFER_INDICES);
+		if (filter(STATE_CALL_BIND_BUFFER_BASE, known && (indexedBuffers[indexed][index] == buffer) && (buffers[bufferSlot(target)] == buffer)))
+		{
+			glBindBufferBase(target, index, buffer);
+			// Also changes the generic binding point
+			int32_t slot = bufferSlot(target);
+			if (slot >= 0)
+			{
+				buffers[slot] = buffer;
+			}
+			if (known)
+			{
+				indexedBuffers[indexed][index] = buffer;
+			}
+		}
+	}
+
+	void bindVertexArray(GLuint vertexArray)
+	{
+		if (filter(STATE_CALL_BIND_VERTEX_ARRAY, this->vertexArray == vertexArray))
+		{
+			glBindVertexArray(vertexArray);
+			this->vertexArray = vertexArray;
+			invalidateVertexArrayState();
+		}
+	}
+
+	void activeTexture(GLenum unit)
+	{
+		if (filter(STATE_CALL_ACTIVE_TEXTURE, activeTextureUnit == unit))
+		{
+			glActiveTexture(unit);
+			activeTextureUnit = unit;
+		}
+	}
+
+	void bindTexture(GLenum target, GLuint texture)
+	{
+		int32_t slot = textureSlot(target);
+		// Bindings are per texture unit, so the active unit has to be known
+		uint32_t unit = (activeTextureUnit != unknown) ? activeTextureUnit - GL_TEXTURE0 : STATE_CACHE_MAX_TEXTURE_UNITS;
+		bool known = (slot >= 0) && (unit < STATE_CACHE_MAX_TEXTURE_UNITS);
+		if (filter(STATE_CALL_BIND_TEXTURE, known && (textures[unit][slot] == texture)))
+		{
+			glBindTexture(target, texture);
+			if (known)
+			{
+				textures[unit][slot] = texture;
+			}
+		}
+	}
+
+	void enable(GLenum capability)
+	{
+		auto it = capabilities.find(capability);
+		if (filter(STATE_CALL_ENABLE, (it != capabilities.end()) && (it->second == 1)))
+		{
+			glEnable(capability);
+			capabilities[capability] = 1;
+		}
+	}
+
+	void disable(GLenum capability)
+	{
+		auto it = capabilities.find(capability);
+		if (filter(STATE_CALL_DISABLE, (it != capabilities.end()) && (it->second == 0)))
+		{
+			glDisable(capability);
+			capabilities[capability] = 0;
+		}
+	}
+
+	void blendFunc(GLenum src, GLenum dst)
+	{
+		if (filter(STATE_CALL_BLEND_FUNC, (blendSrc == src) && (blendDst == dst)))
+		{
+			glBlendFunc(src, dst);
+			blendSrc = src;
+			blendDst = dst;
+		}
+	}
+
+	void enableVertexAttribArray(GLuint index)
+	{
+		bool known = (index < STATE_CACHE_MAX_VERTEX_ATTRIBS);
+		if (filter(STATE_CALL_ENABLE_VERTEX_ATTRIB_ARRAY, known && (vertexAttribEnabled[index] == 1)))
+		{
+			glEnableVertexAttribArray(index);
+			if (known)
+			{
+				vertexAttribEnabled[index] = 1;
+			}
+		}
+	}
+
+	// Locations are queried from the driver once per program and name
+	GLint getUniformLocation(GLuint program, const char* name)
+	{
+		auto& locations = uniformLocations[program];
+		auto it = locations.find(name);
+		if (!filter(STATE_CALL_GET_UNIFORM_LOCATION, it != locations.end()))
+		{
+			return it->second;
+		}
+		GLint location = glGetUniformLocation(program, name);
+		locations[name] = location;
+		return location;
+	}
+
+	GLint getAttribLocation(GLuint program, const char* name)
+	{
+		auto& locations = attribLocations[program];
+		auto it = locations.find(name);
+		if (!filter(STATE_CALL_GET_ATTRIB_LOCATION, it != locations.end()))
+		{
+			return it->second;
+		}
+		GLint location = glGetAttribLocation(program, name);
+		locations[name] = location;
+		return location;
+	}
+
+	// Prints the call counters of the last completed frame
+	void printReport() const
+	{
+		uint32_t total = 0, filtered = 0, issued = 0;
+		printf("%-28s %8s %8s %8s\n", "GL state calls per frame", "total", "filtered", "issued");
+		for (uint32_t call = 0; call < STATE_CALL_COUNT; call++)
+		{
+			if (lastFrame.total[call] == 0)
+			{
+				continue;
+			}
+			printf("%-28s %8u %8u %8u\n", getCallName(call), lastFrame.total[call], lastFrame.filtered[call], lastFrame.issued[call]);
+			total += lastFrame.total[call];
+			filtered += lastFrame.filtered[call];
+			issued += lastFrame.issued[call];
+		}
+		printf("%-28s %8u %8u %8u\n", "all", total, filtered, issued);
+	}
+};
@@ -0,0 +1,209 @@
+/*
+* On disk cache for linked program binaries (GL_ARB_get_program_binary)
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#define PROGRAM_CACHE_MAGIC 0x42504C47
+#define PROGRAM_CACHE_VERSION 1
+
+// Program binaries are stored in one file per program, named after a 64 bit hash of
+// all shader sources and the GL vendor, renderer and version strings
+// A binary is only valid for the exact driver that created it, so a driver update
+// results in new keys (and glProgramBinary failing is handled as a miss)
+class ProgramCache
+{
+private:
+	std::string directory;
+	std::string driverId;
+	bool supported = false;
+	bool initialized = false;
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t binarySize;
+		// Time it took to compile and link the program from source, used to report the time saved on a hit
+		double compileTime;
+	};
+
+	void initialize()
+	{
+		if (initialized)
+		{
+			return;
+		}
+		initialized = true;
+		GLint formatCount = 0;
+		if (GLEW_ARB_get_program_binary)
+		{
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		}
+		supported = (formatCount > 0);
+		if (!supported)
+		{
+			printf("Program cache: no program binary formats supported, cache disabled\n");
+			return;
+		}
+		driverId = std::string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+
+	std::string getFileName(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return directory + "/" + name;
+	}
+
+public:
+	struct Stats
+	{
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		// Sum of (compile time - load time) over all hits in seconds
+		double timeSaved = 0.0;
+	} stats;
+
+	ProgramCache(const std::string &directory = "shadercache")
+	{
+		this->directory = directory;
+	}
+
+	static uint64_t fnv1a64(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const uint8_t *bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Builds the cache key from the program's sources, the caller adds everything that affects the binary
+	// (stage types, sources, attribute bindings), the driver strings are added here
+	uint64_t makeKey(uint64_t sourceHash)
+	{
+		initialize();
+		return fnv1a64(driverId.data(), driverId.size(), sourceHash);
+	}
+
+	bool isSupported()
+	{
+		initialize();
+		return supported;
+	}
+
+	// Tries to load the binary for the given key into the program, returns false on a miss
+	bool load(uint64_t key, GLuint program)
+	{
+		if (!isSupported())
+		{
+			return false;
+		}
+		double loadStart = glfwGetTime();
+
+		FILE *file = fopen(getFileName(key).c_str(), "rb");
+		if (!file)
+		{
+			stats.misses++;
+			printf("Program cache miss (%016llx)\n", (unsigned long long)key);
+			return false;
+		}
+		FileHeader header;
+		std::vector<uint8_t> binary;
+		bool valid = (fread(&header, sizeof(header), 1, file) == 1) && (header.magic == PROGRAM_CACHE_MAGIC) && (header.version == PROGRAM_CACHE_VERSION) && (header.key == key);
+		if (valid)
+		{
+			binary.resize(header.binarySize);
+			valid = (fread(binary.data(), 1, binary.size(), file) == binary.size());
+		}
+		fclose(file);
+
+		GLint status = GL_FALSE;
+		if (valid)
+		{
+			glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+		}
+		if (status != GL_TRUE)
+		{
+			// Stale or corrupt binary, will be replaced after compiling from source
+			stats.misses++;
+			printf("Program cache miss (%016llx), stored binary rejected\n", (unsigned long long)key);
+			return false;
+		}
+
+		double loadTime = glfwGetTime() - loadStart;
+		stats.hits++;
+		stats.timeSaved += header.compileTime - loadTime;
+		printf("Program cache hit (%016llx): loaded in %.2f ms, saved %.2f ms\n", (unsigned long long)key, loadTime * 1000.0, (header.compileTime - loadTime) * 1000.0);
+		return true;
+	}
+
+	// Stores the binary of a successfully linked program
+	// The program should be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	void store(uint64_t key, GLuint program, double compileTime)
+	{
+		if (!isSupported())
+		{
+			return;
+		}
+		GLint binaryLength = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+		if (binaryLength <= 0)
+		{
+			return;
+		}
+		std::vector<uint8_t> binary(binaryLength);
+		GLenum binaryFormat = 0;
+		glGetProgramBinary(program, binaryLength, NULL, &binaryFormat, binary.data());
+
+		FileHeader header;
+		header.magic = PROGRAM_CACHE_MAGIC;
+		header.version = PROGRAM_CACHE_VERSION;
+		header.key = key;
+		header.binaryFormat = binaryFormat;
+		header.binarySize = (uint32_t)binary.size();
+		header.compileTime = compileTime;
+
+		FILE *file = fopen(getFileName(key).c_str(), "wb");
+		if (!file)
+		{
+			printf("Program cache: could not write %s\n", getFileName(key).c_str());
+			return;
+		}
+		fwrite(&header, sizeof(header), 1, file);
+		fwrite(binary.data(), 1, binary.size(), file);
+		fclose(file);
+	}
+
+	void printStats() const
+	{
+		printf("Program cache: %u hits, %u misses, %.2f ms saved\n", stats.hits, stats.misses, stats.timeSaved * 1000.0);
+	}
+};
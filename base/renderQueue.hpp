@@ -0,0 +1,179 @@
+/*
+* Sort key based render queue
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+// Bit layout of the 64 bit sort key (msb to lsb)
+// Draws are sorted by pass first, then by program, then by material and finally by depth
+#define RENDER_KEY_PASS_BITS 8
+#define RENDER_KEY_PROGRAM_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 20
+#define RENDER_KEY_DEPTH_BITS 24
+
+// Everything needed to issue a single (instanced) indexed draw
+struct RenderPacket
+{
+	uint64_t key = 0;
+	GLuint program = 0;
+	GLuint vertexArray = 0;
+	// Optional uniform buffer with material parameters and its binding point
+	GLuint materialBuffer = 0;
+	GLuint materialBinding = 0;
+	// Optional texture bound to unit 0
+	GLuint texture = 0;
+	GLenum mode = GL_TRIANGLES;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	const void *indexOffset = nullptr;
+	GLsizei instanceCount = 1;
+};
+
+// Draws are submitted as packets during the frame, sorted by their key and
+// then executed with only those state changes that are actually required
+class RenderQueue
+{
+private:
+	std::vector<RenderPacket> packets;
+	// Packet indices, sorted by key
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> orderTemp;
+
+	// LSD radix sort over the keys with 8 bit digits, only the indices are moved
+	// Digits that are the same for all keys (e.g. unused depth bits) are skipped
+	void sort()
+	{
+		uint32_t count = static_cast<uint32_t>(packets.size());
+		order.resize(count);
+		orderTemp.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			order[i] = i;
+		}
+		if (count < 2)
+		{
+			return;
+		}
+
+		for (uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			uint32_t histogram[256] = {};
+			for (uint32_t i = 0; i < count; i++)
+			{
+				histogram[(packets[i].key >> shift) & 0xFF]++;
+			}
+			if (histogram[(packets[0].key >> shift) & 0xFF] == count)
+			{
+				continue;
+			}
+			uint32_t sum = 0;
+			for (uint32_t digit = 0; digit < 256; digit++)
+			{
+				uint32_t c = histogram[digit];
+				histogram[digit] = sum;
+				sum += c;
+			}
+			for (uint32_t i = 0; i < count; i++)
+			{
+				uint32_t index = order[i];
+				orderTemp[histogram[(packets[index].key >> shift) & 0xFF]++] = index;
+			}
+			order.swap(orderTemp);
+		}
+	}
+
+public:
+	// State changes issued by the last call to execute()
+	struct Stats
+	{
+		uint32_t draws = 0;
+		uint32_t programChanges = 0;
+		uint32_t vertexArrayChanges = 0;
+		uint32_t materialChanges = 0;
+		uint32_t textureChanges = 0;
+	} stats;
+
+	// Builds a sort key, depth is expected to be normalized to [0..1]
+	// Set backToFront for passes that need to be drawn from far to near (e.g. blending)
+	static uint64_t makeKey(uint32_t pass, uint32_t program, uint32_t material, float depth, bool backToFront = false)
+	{
+		const uint64_t depthMax = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+		uint64_t depthBits = static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * depthMax);
+		if (backToFront)
+		{
+			depthBits = depthMax - depthBits;
+		}
+		uint64_t key = pass & ((1u << RENDER_KEY_PASS_BITS) - 1);
+		key = (key << RENDER_KEY_PROGRAM_BITS) | (program & ((1u << RENDER_KEY_PROGRAM_BITS) - 1));
+		key = (key << RENDER_KEY_MATERIAL_BITS) | (material & ((1u << RENDER_KEY_MATERIAL_BITS) - 1));
+		key = (key << RENDER_KEY_DEPTH_BITS) | depthBits;
+		return key;
+	}
+
+	void submit(const RenderPacket &packet)
+	{
+		packets.push_back(packet);
+	}
+
+	uint32_t size() const
+	{
+		return static_cast<uint32_t>(packets.size());
+	}
+
+	void clear()
+	{
+		packets.clear();
+	}
+
+	// Sorts and draws all submitted packets, the queue is cleared afterwards
+	// GL state is not assumed to be known from previous frames, so the first packet binds everything
+	void execute()
+	{
+		stats = Stats();
+		sort();
+
+		bool first = true;
+		RenderPacket current;
+		for (uint32_t index : order)
+		{
+			const RenderPacket &packet = packets[index];
+			if (first || (packet.program != current.program))
+			{
+				glUseProgram(packet.program);
+				stats.programChanges++;
+			}
+			if (first || (packet.vertexArray != current.vertexArray))
+			{
+				glBindVertexArray(packet.vertexArray);
+				stats.vertexArrayChanges++;
+			}
+			if ((packet.materialBuffer != 0) && (first || (packet.materialBuffer != current.materialBuffer) || (packet.materialBinding != current.materialBinding)))
+			{
+				glBindBufferBase(GL_UNIFORM_BUFFER, packet.materialBinding, packet.materialBuffer);
+				stats.materialChanges++;
+			}
+			if ((packet.texture != 0) && (first || (packet.texture != current.texture)))
+			{
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, packet.texture);
+				stats.textureChanges++;
+			}
+			glDrawElementsInstanced(packet.mode, packet.indexCount, packet.indexType, packet.indexOffset, packet.instanceCount);
+			stats.draws++;
+			current = packet;
+			first = false;
+		}
+
+		packets.clear();
+	}
+};
@@ -0,0 +1,128 @@
+/*
+* Non blocking program compilation using GL_KHR_parallel_shader_compile
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "shaderProgram.hpp"
+
+// All programs are submitted up front without querying any compile or link state
+// poll() is called once per frame and finishes the programs the driver is done with, so
+// the application can start rendering with the programs that are ready
+// Without GL_KHR_parallel_shader_compile programs are reported as ready immediately and
+// finishing them blocks as before
+class ShaderCompileManager
+{
+private:
+	std::vector<ShaderProgram*> pending;
+	bool configured = false;
+	double submitTime = 0.0;
+
+	void configure()
+	{
+		if (configured)
+		{
+			return;
+		}
+		configured = true;
+		if (GLEW_KHR_parallel_shader_compile)
+		{
+			// 0xFFFFFFFF lets the implementation pick the number of compiler threads
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+			printf("Parallel shader compilation enabled (GL_KHR_parallel_shader_compile)\n");
+		}
+	}
+
+public:
+	struct Stats
+	{
+		uint32_t submitted = 0;
+		uint32_t completed = 0;
+		uint32_t failed = 0;
+	} stats;
+
+	// Submits the program's stages for compilation, the stages have to be added before
+	// The program must stay at the same address until it's finished
+	void add(ShaderProgram &program)
+	{
+		configure();
+		if (pending.empty())
+		{
+			submitTime = glfwGetTime();
+		}
+		stats.submitted++;
+		program.submit();
+		if (program.isPending())
+		{
+			pending.push_back(&program);
+		}
+		else
+		{
+			// Loaded from the program cache (or failed to)
+			stats.completed++;
+			stats.failed += program.isLinked() ? 0 : 1;
+		}
+	}
+
+	// Finishes all programs that have completed compilation without blocking
+	// Returns the number of programs that are still being compiled
+	uint32_t poll()
+	{
+		if (pending.empty())
+		{
+			return 0;
+		}
+		for (size_t i = 0; i < pending.size(); )
+		{
+			if (pending[i]->isCompletionReady())
+			{
+				if (!pending[i]->finish())
+				{
+					stats.failed++;
+				}
+				stats.completed++;
+				pending[i] = pending.back();
+				pending.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+		if (pending.empty())
+		{
+			printf("%u programs ready %.2f ms after submission (%u failed)\n", stats.completed, (glfwGetTime() - submitTime) * 1000.0, stats.failed);
+		}
+		return static_cast<uint32_t>(pending.size());
+	}
+
+	// Blocks until all submitted programs are finished
+	void finishAll()
+	{
+		for (auto program : pending)
+		{
+			if (!program->finish())
+			{
+				stats.failed++;
+			}
+			stats.completed++;
+		}
+		pending.clear();
+	}
+
+	bool isIdle() const
+	{
+		return pending.empty();
+	}
+};
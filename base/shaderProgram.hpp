@@ -0,0 +1,778 @@
+/*
+* Shader program with reflection, cached locations and redundant uniform update filtering
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "programCache.hpp"
+#include "spirvShader.hpp"
+
+// Open addressing hash table (linear probing) mapping resource names to locations
+// Filled once after linking, lookups don't allocate
+class ShaderLocationTable
+{
+private:
+	struct Entry
+	{
+		std::string name;
+		uint32_t hash = 0;
+		GLint location = -1;
+		// Index into user data (e.g. cached uniform values), -1 if unused
+		int32_t slot = -1;
+		bool used = false;
+	};
+	std::vector<Entry> entries;
+	uint32_t count = 0;
+
+	static uint32_t fnv1a(const char *str)
+	{
+		uint32_t hash = 2166136261u;
+		while (*str)
+		{
+			hash ^= (uint8_t)*str++;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	void grow()
+	{
+		std::vector<Entry> old;
+		old.swap(entries);
+		entries.resize(old.empty() ? 16 : old.size() * 2);
+		count = 0;
+		for (auto& entry : old)
+		{
+			if (entry.used)
+			{
+				insert(entry.name.c_str(), entry.location, entry.slot);
+			}
+		}
+	}
+
+	const Entry* findEntry(const char *name) const
+	{
+		if (entries.empty())
+		{
+			return nullptr;
+		}
+		uint32_t hash = fnv1a(name);
+		uint32_t mask = static_cast<uint32_t>(entries.size()) - 1;
+		for (uint32_t i = hash & mask; ; i = (i + 1) & mask)
+		{
+			const Entry &entry = entries[i];
+			if (!entry.used)
+			{
+				return nullptr;
+			}
+			if ((entry.hash == hash) && (entry.name == name))
+			{
+				return &entry;
+			}
+		}
+	}
+
+public:
+	void insert(const char *name, GLint location, int32_t slot = -1)
+	{
+		// Keep the load factor below 50 percent
+		if ((count + 1) * 2 > entries.size())
+		{
+			grow();
+		}
+		uint32_t hash = fnv1a(name);
+		uint32_t mask = static_cast<uint32_t>(entries.size()) - 1;
+		uint32_t i = hash & mask;
+		while (entries[i].used && !((entries[i].hash == hash) && (entries[i].name == name)))
+		{
+			i = (i + 1) & mask;
+		}
+		if (!entries[i].used)
+		{
+			count++;
+		}
+		entries[i].name = name;
+		entries[i].hash = hash;
+		entries[i].location = location;
+		entries[i].slot = slot;
+		entries[i].used = true;
+	}
+
+	// Returns -1 if the name is not found
+	GLint find(const char *name) const
+	{
+		const Entry *entry = findEntry(name);
+		return entry ? entry->location : -1;
+	}
+
+	int32_t findSlot(const char *name) const
+	{
+		const Entry *entry = findEntry(name);
+		return entry ? entry->slot : -1;
+	}
+
+	uint32_t size() const
+	{
+		return count;
+	}
+
+	void clear()
+	{
+		entries.clear();
+		count = 0;
+	}
+};
+
+// Compiles and links a program from individual stages and reflects all active resources once after linking
+// If a program cache is set, the linked binary is stored on disk and loaded from there on the next start
+// Uniform setters remember the last value and skip the GL call if it didn't change
+// Note: Setters use glUniform*, so the program has to be in use
+// Stages can also be SPIR-V modules (GL_ARB_gl_spirv) that are specialized with constants at submit()
+// Note: No destructor (samples copy their renderer around), call destroy() while the context is current
+class ShaderProgram
+{
+private:
+	// Last value set for a uniform, up to a 4x4 matrix
+	struct UniformValue
+	{
+		GLint location;
+		GLenum type;
+		GLint arraySize;
+		bool valid = false;
+		uint32_t data[16];
+	};
+
+	// Stage sources, compiled and released by link()
+	// SPIR-V stages store the module instead of a source
+	struct Stage
+	{
+		GLenum type;
+		std::string source;
+		std::vector<uint32_t> spirv;
+		std::string entryPoint;
+		SpecializationConstants constants;
+	};
+	std::vector<Stage> stages;
+	std::vector<std::pair<GLuint, std::string>> attribBindings;
+	// Names for uniforms with explicit locations, SPIR-V programs don't need to keep uniform names
+	std::vector<std::pair<std::string, GLint>> uniformAliases;
+	std::vector<UniformValue> uniformValues;
+	ShaderLocationTable uniforms;
+	ShaderLocationTable attributes;
+	ShaderLocationTable uniformBlocks;
+	ShaderLocationTable storageBlocks;
+	bool linked = false;
+	// Set between submit() and finish()
+	bool pending = false;
+	bool specializationFailed = false;
+	std::vector<GLuint> pendingShaders;
+	uint64_t cacheKey = 0;
+	double compileStart = 0.0;
+
+	static std::string readFile(const char *fileName)
+	{
+		std::ifstream fileStream(fileName, std::ios::in);
+		if (!fileStream.is_open())
+		{
+			printf("File %s not found\n", fileName);
+			return "";
+		}
+		std::stringstream buffer;
+		buffer << fileStream.rdbuf();
+		return buffer.str();
+	}
+
+	static const char* getStageName(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_VERTEX_SHADER: return "vertex";
+		case GL_FRAGMENT_SHADER: return "fragment";
+		case GL_GEOMETRY_SHADER: return "geometry";
+		case GL_TESS_CONTROL_SHADER: return "tessellation control";
+		case GL_TESS_EVALUATION_SHADER: return "tessellation evaluation";
+		case GL_COMPUTE_SHADER: return "compute";
+		default: return "unknown";
+		}
+	}
+
+	void addUniform(std::string name, GLint location, GLenum type, GLint arraySize)
+	{
+		if (location < 0)
+		{
+			// Block members and atomic counters have no location
+			return;
+		}
+		int32_t slot = static_cast<int32_t>(uniformValues.size());
+		UniformValue value;
+		value.location = location;
+		value.type = type;
+		value.arraySize = arraySize;
+		uniformValues.push_back(value);
+		uniforms.insert(name.c_str(), location, slot);
+		// Arrays are reported as "name[0]", also make them available as "name"
+		if ((name.size() > 3) && (name.compare(name.size() - 3, 3, "[0]") == 0))
+		{
+			uniforms.insert(name.substr(0, name.size() - 3).c_str(), location, slot);
+		}
+	}
+
+	void reflectProgramInterface()
+	{
+		std::vector<char> name;
+		GLint count = 0;
+		GLint maxLength = 0;
+
+		// Uniforms
+		glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+		glGetProgramInterfaceiv(program, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			const GLenum props[] = { GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+			GLint values[3];
+			glGetProgramResourceiv(program, GL_UNIFORM, i, 3, props, 3, NULL, values);
+			glGetProgramResourceName(program, GL_UNIFORM, i, (GLsizei)name.size(), NULL, name.data());
+			addUniform(name.data(), values[0], values[1], values[2]);
+		}
+
+		// Vertex inputs
+		glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+		glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_MAX_NAME_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			const GLenum props[] = { GL_LOCATION };
+			GLint location;
+			glGetProgramResourceiv(program, GL_PROGRAM_INPUT, i, 1, props, 1, NULL, &location);
+			glGetProgramResourceName(program, GL_PROGRAM_INPUT, i, (GLsizei)name.size(), NULL, name.data());
+			attributes.insert(name.data(), location);
+		}
+
+		// Uniform blocks, the block index is stored as the location
+		glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+		glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			glGetProgramResourceName(program, GL_UNIFORM_BLOCK, i, (GLsizei)name.size(), NULL, name.data());
+			uniformBlocks.insert(name.data(), i);
+		}
+
+		// Shader storage blocks
+		glGetProgramInterfaceiv(program, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &count);
+		glGetProgramInterfaceiv(program, GL_SHADER_STORAGE_BLOCK, GL_MAX_NAME_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			glGetProgramResourceName(program, GL_SHADER_STORAGE_BLOCK, i, (GLsizei)name.size(), NULL, name.data());
+			storageBlocks.insert(name.data(), i);
+		}
+	}
+
+	// Pre 4.3 path, no shader storage blocks
+	void reflectLegacy()
+	{
+		std::vector<char> name;
+		GLint count = 0;
+		GLint maxLength = 0;
+
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint size;
+			GLenum type;
+			glGetActiveUniform(program, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+			addUniform(name.data(), glGetUniformLocation(program, name.data()), type, size);
+		}
+
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint size;
+			GLenum type;
+			glGetActiveAttrib(program, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+			attributes.insert(name.data(), glGetAttribLocation(program, name.data()));
+		}
+
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			glGetActiveUniformBlockName(program, i, (GLsizei)name.size(), NULL, name.data());
+			uniformBlocks.insert(name.data(), i);
+		}
+	}
+
+	void applyUniformAliases()
+	{
+		for (auto& alias : uniformAliases)
+		{
+			if (uniforms.find(alias.first.c_str()) >= 0)
+			{
+				continue;
+			}
+			int32_t slot = -1;
+			for (size_t i = 0; i < uniformValues.size(); i++)
+			{
+				if (uniformValues[i].location == alias.second)
+				{
+					slot = static_cast<int32_t>(i);
+					break;
+				}
+			}
+			if (slot < 0)
+			{
+				slot = static_cast<int32_t>(uniformValues.size());
+				UniformValue value;
+				value.location = alias.second;
+				value.type = GL_NONE;
+				value.arraySize = 1;
+				uniformValues.push_back(value);
+			}
+			uniforms.insert(alias.first.c_str(), alias.second, slot);
+		}
+	}
+
+	// Returns the cached value for the uniform if the new data differs (or nothing was set yet), null otherwise
+	UniformValue* changed(const char *name, const void *data, size_t size)
+	{
+		int32_t slot = uniforms.findSlot(name);
+		if (slot < 0)
+		{
+			return nullptr;
+		}
+		UniformValue &value = uniformValues[slot];
+		if (value.valid && (memcmp(value.data, data, size) == 0))
+		{
+			skippedUpdates++;
+			return nullptr;
+		}
+		memcpy(value.data, data, size);
+		value.valid = true;
+		return &value;
+	}
+
+public:
+	GLuint program = 0;
+	// Number of uniform updates that were skipped because the value didn't change
+	uint64_t skippedUpdates = 0;
+
+	// Optional binary cache, programs are loaded from it instead of being compiled if possible
+	ProgramCache *cache = nullptr;
+
+	// Adds a stage, sources are compiled by link()
+	bool addStage(GLenum type, const std::string &source)
+	{
+		Stage stage;
+		stage.type = type;
+		stage.source = source;
+		stages.push_back(stage);
+		return !source.empty();
+	}
+
+	bool addStageFromFile(GLenum type, const char *fileName)
+	{
+		return addStage(type, readFile(fileName));
+	}
+
+	// Adds a SPIR-V stage, the module is specialized with the given constants when the program is submitted
+	bool addStageBinary(GLenum type, const std::vector<uint32_t> &spirv, const SpecializationConstants &constants = SpecializationConstants(), const char *entryPoint = "main")
+	{
+		Stage stage;
+		stage.type = type;
+		stage.spirv = spirv;
+		stage.entryPoint = entryPoint;
+		stage.constants = constants;
+		stages.push_back(stage);
+		return !spirv.empty();
+	}
+
+	bool addStageBinaryFromFile(GLenum type, const char *fileName, const SpecializationConstants &constants = SpecializationConstants(), const char *entryPoint = "main")
+	{
+		std::vector<uint32_t> spirv;
+		if (!readSpirvFile(fileName, spirv))
+		{
+			printf("File %s not found\n", fileName);
+		}
+		return addStageBinary(type, spirv, constants, entryPoint);
+	}
+
+	// Makes a uniform with an explicit location available by name
+	// Needed for the name based setters on SPIR-V programs, as these don't have to keep uniform names
+	void addUniformAlias(const char *name, GLint location)
+	{
+		uniformAliases.push_back(std::make_pair(std::string(name), location));
+	}
+
+	// Returns a new, empty program with the same settings (cache, attribute bindings), used to build variants and reloads
+	ShaderProgram cloneSettings() const
+	{
+		ShaderProgram clone;
+		clone.cache = cache;
+		clone.attribBindings = attribBindings;
+		clone.uniformAliases = uniformAliases;
+		return clone;
+	}
+
+	// Has to be called before link()
+	void bindAttribLocation(GLuint index, const char *name)
+	{
+		attribBindings.push_back(std::make_pair(index, std::string(name)));
+	}
+
+	// Hash over everything that affects the linked program
+	uint64_t getSourceHash() const
+	{
+		uint64_t hash = ProgramCache::fnv1a64(nullptr, 0);
+		for (auto& stage : stages)
+		{
+			hash = ProgramCache::fnv1a64(&stage.type, sizeof(stage.type), hash);
+			hash = ProgramCache::fnv1a64(stage.source.data(), stage.source.size(), hash);
+			hash = ProgramCache::fnv1a64(stage.spirv.data(), stage.spirv.size() * sizeof(uint32_t), hash);
+			hash = ProgramCache::fnv1a64(stage.entryPoint.data(), stage.entryPoint.size(), hash);
+			hash = ProgramCache::fnv1a64(stage.constants.ids.data(), stage.constants.ids.size() * sizeof(GLuint), hash);
+			hash = ProgramCache::fnv1a64(stage.constants.values.data(), stage.constants.values.size() * sizeof(GLuint), hash);
+		}
+		for (auto& binding : attribBindings)
+		{
+			hash = ProgramCache::fnv1a64(&binding.first, sizeof(binding.first), hash);
+			hash = ProgramCache::fnv1a64(binding.second.data(), binding.second.size(), hash);
+		}
+		return hash;
+	}
+
+	// Starts compiling and linking all stages (or loads the program from the cache)
+	// No state is queried, so with GL_KHR_parallel_shader_compile the driver can work on this in the background
+	void submit()
+	{
+		if (program == 0)
+		{
+			program = glCreateProgram();
+		}
+		linked = false;
+		specializationFailed = false;
+
+		cacheKey = 0;
+		if (cache)
+		{
+			cacheKey = cache->makeKey(getSourceHash());
+			if (cache->load(cacheKey, program))
+			{
+				stages.clear();
+				linked = true;
+				reflect();
+				return;
+			}
+		}
+
+		compileStart = glfwGetTime();
+		for (auto& stage : stages)
+		{
+			if (!stage.spirv.empty())
+			{
+				// Specialization compiles the module right away, failures are reported by finish()
+				std::cout << "Specializing " << getStageName(stage.type) << " shader (" << stage.constants.ids.size() << " constants)." << std::endl;
+				GLuint shader = loadSpirvStage(stage.type, stage.spirv, stage.entryPoint.c_str(), stage.constants);
+				if (shader == 0)
+				{
+					specializationFailed = true;
+					continue;
+				}
+				pendingShaders.push_back(shader);
+				continue;
+			}
+			GLuint shader = glCreateShader(stage.type);
+			const char *src = stage.source.c_str();
+			std::cout << "Compiling " << getStageName(stage.type) << " shader." << std::endl;
+			glShaderSource(shader, 1, &src, NULL);
+			glCompileShader(shader);
+			pendingShaders.push_back(shader);
+		}
+		stages.clear();
+
+		std::cout << "Linking program" << std::endl;
+		for (auto shader : pendingShaders)
+		{
+			glAttachShader(program, shader);
+		}
+		for (auto& binding : attribBindings)
+		{
+			glBindAttribLocation(program, binding.first, binding.second.c_str());
+		}
+		if (cache)
+		{
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		glLinkProgram(program);
+		pending = true;
+	}
+
+	// True if finish() won't block, always true without parallel shader compile support
+	bool isCompletionReady() const
+	{
+		if (!pending)
+		{
+			return true;
+		}
+		if (!GLEW_KHR_parallel_shader_compile)
+		{
+			return true;
+		}
+		GLint completed = GL_FALSE;
+		glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+		return (completed == GL_TRUE);
+	}
+
+	bool isPending() const
+	{
+		return pending;
+	}
+
+	// Checks compile and link results of a submitted program and reflects its resources
+	// Blocks if the driver is still compiling
+	bool finish()
+	{
+		if (!pending)
+		{
+			return linked;
+		}
+		pending = false;
+
+		bool compiled = !specializationFailed;
+		for (auto shader : pendingShaders)
+		{
+			GLint status = GL_FALSE;
+			GLint logLength = 0;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+			if (logLength > 1)
+			{
+				std::vector<GLchar> log(logLength + 1);
+				glGetShaderInfoLog(shader, logLength, NULL, log.data());
+				printf("shaderlog: %s\n", log.data());
+			}
+			compiled &= (status == GL_TRUE);
+		}
+
+		GLint status = GL_FALSE;
+		GLint logLength = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		if (logLength > 1)
+		{
+			std::vector<GLchar> log(logLength + 1);
+			glGetProgramInfoLog(program, logLength, NULL, log.data());
+			printf("programlog: %s\n", log.data());
+		}
+
+		// Shaders are no longer needed once the program has been linked
+		for (auto shader : pendingShaders)
+		{
+			glDetachShader(program, shader);
+			glDeleteShader(shader);
+		}
+		pendingShaders.clear();
+
+		linked = compiled && (status == GL_TRUE);
+		if (linked)
+		{
+			if (cache)
+			{
+				cache->store(cacheKey, program, glfwGetTime() - compileStart);
+			}
+			reflect();
+		}
+		return linked;
+	}
+
+	// Compiles and links all stages (or loads the program from the cache) and reflects the program's resources
+	bool link()
+	{
+		submit();
+		return finish();
+	}
+
+	// (Re)builds the location tables, called by link()
+	void reflect()
+	{
+		uniforms.clear();
+		attributes.clear();
+		uniformBlocks.clear();
+		storageBlocks.clear();
+		uniformValues.clear();
+		if (GLEW_VERSION_4_3 || GLEW_ARB_program_interface_query)
+		{
+			reflectProgramInterface();
+		}
+		else
+		{
+			reflectLegacy();
+		}
+		applyUniformAliases();
+	}
+
+	// Convenience loaders for the common stage combinations
+	bool load(const char *vertexShaderFile, const char *fragmentShaderFile, const char *geometryShaderFile = nullptr)
+	{
+		bool result = addStageFromFile(GL_VERTEX_SHADER, vertexShaderFile);
+		result &= addStageFromFile(GL_FRAGMENT_SHADER, fragmentShaderFile);
+		if (geometryShaderFile)
+		{
+			result &= addStageFromFile(GL_GEOMETRY_SHADER, geometryShaderFile);
+		}
+		return link() && result;
+	}
+
+	bool loadCompute(const char *computeShaderFile)
+	{
+		bool result = addStageFromFile(GL_COMPUTE_SHADER, computeShaderFile);
+		return link() && result;
+	}
+
+	void destroy()
+	{
+		stages.clear();
+		for (auto shader : pendingShaders)
+		{
+			glDeleteShader(shader);
+		}
+		pendingShaders.clear();
+		pending = false;
+		if (program != 0)
+		{
+			glDeleteProgram(program);
+		}
+		program = 0;
+		linked = false;
+	}
+
+	bool isLinked() const
+	{
+		return linked;
+	}
+
+	void use() const
+	{
+		glUseProgram(program);
+	}
+
+	GLint getUniformLocation(const char *name) const
+	{
+		return uniforms.find(name);
+	}
+
+	GLint getAttribLocation(const char *name) const
+	{
+		return attributes.find(name);
+	}
+
+	GLint getUniformBlockIndex(const char *name) const
+	{
+		return uniformBlocks.find(name);
+	}
+
+	GLint getStorageBlockIndex(const char *name) const
+	{
+		return storageBlocks.find(name);
+	}
+
+	void bindUniformBlock(const char *name, GLuint binding)
+	{
+		GLint index = uniformBlocks.find(name);
+		if (index >= 0)
+		{
+			glUniformBlockBinding(program, index, binding);
+		}
+	}
+
+	void bindStorageBlock(const char *name, GLuint binding)
+	{
+		GLint index = storageBlocks.find(name);
+		if (index >= 0)
+		{
+			glShaderStorageBlockBinding(program, index, binding);
+		}
+	}
+
+	void setInt(const char *name, GLint value)
+	{
+		if (UniformValue *uniform = changed(name, &value, sizeof(value)))
+		{
+			glUniform1i(uniform->location, value);
+		}
+	}
+
+	void setUInt(const char *name, GLuint value)
+	{
+		if (UniformValue *uniform = changed(name, &value, sizeof(value)))
+		{
+			glUniform1ui(uniform->location, value);
+		}
+	}
+
+	void setFloat(const char *name, GLfloat value)
+	{
+		if (UniformValue *uniform = changed(name, &value, sizeof(value)))
+		{
+			glUniform1f(uniform->location, value);
+		}
+	}
+
+	void setVec2(const char *name, GLfloat x, GLfloat y)
+	{
+		const GLfloat value[] = { x, y };
+		if (UniformValue *uniform = changed(name, value, sizeof(value)))
+		{
+			glUniform2fv(uniform->location, 1, value);
+		}
+	}
+
+	void setVec3(const char *name, GLfloat x, GLfloat y, GLfloat z)
+	{
+		const GLfloat value[] = { x, y, z };
+		if (UniformValue *uniform = changed(name, value, sizeof(value)))
+		{
+			glUniform3fv(uniform->location, 1, value);
+		}
+	}
+
+	void setVec4(const char *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+	{
+		const GLfloat value[] = { x, y, z, w };
+		if (UniformValue *uniform = changed(name, value, sizeof(value)))
+		{
+			glUniform4fv(uniform->location, 1, value);
+		}
+	}
+
+	// Column major 4x4 matrix
+	void setMat4(const char *name, const GLfloat *value)
+	{
+		if (UniformValue *uniform = changed(name, value, 16 * sizeof(GLfloat)))
+		{
+			glUniformMatrix4fv(uniform->location, 1, GL_FALSE, value);
+		}
+	}
+};
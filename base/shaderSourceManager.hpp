@@ -0,0 +1,352 @@
+/*
+* Shader source manager with #include resolution, define based variants and hot reload
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include "shaderProgram.hpp"
+#include "shaderCompileManager.hpp"
+
+// A shader stage given by its file name
+struct ShaderStageFile
+{
+	GLenum type;
+	std::string fileName;
+};
+
+// Builds program sources from files:
+// - #include "file" is resolved relative to the including file, each file is included only once per stage
+// - Defines ("NAME" or "NAME=VALUE") are injected after the #version line, so one file can be compiled into several variants
+// - File contents are memoized, so shared includes are only read once
+// Every registered program remembers the files it depends on
+// A background thread polls the modification times of these files, update() then rebuilds affected programs
+// through the compile manager and swaps them in once they linked successfully
+// Note: Owns a thread, so keep it outside of classes that get copied (e.g. as a global next to the renderer)
+class ShaderSourceManager
+{
+private:
+	struct FileEntry
+	{
+		std::string content;
+		bool found = false;
+	};
+
+	struct Registration
+	{
+		ShaderProgram *program;
+		std::vector<ShaderStageFile> stages;
+		std::vector<std::string> defines;
+		std::set<std::string> dependencies;
+		// Replacement program while a reload is being compiled
+		std::unique_ptr<ShaderProgram> staging;
+	};
+
+	std::map<std::string, FileEntry> files;
+	std::vector<std::unique_ptr<Registration>> registrations;
+	std::map<std::string, std::unique_ptr<ShaderProgram>> variants;
+
+	// Shared with the watcher thread
+	std::mutex watchMutex;
+	std::map<std::string, time_t> watchedFiles;
+	std::vector<std::string> changedFiles;
+	std::thread watcher;
+	std::atomic<bool> watching;
+
+	static time_t getModificationTime(const std::string &fileName)
+	{
+		struct stat fileStat;
+		if (stat(fileName.c_str(), &fileStat) != 0)
+		{
+			return 0;
+		}
+		return fileStat.st_mtime;
+	}
+
+	static std::string getDirectory(const std::string &fileName)
+	{
+		size_t pos = fileName.find_last_of("/\\");
+		return (pos == std::string::npos) ? "" : fileName.substr(0, pos + 1);
+	}
+
+	const FileEntry& readFile(const std::string &fileName)
+	{
+		auto it = files.find(fileName);
+		if (it != files.end())
+		{
+			return it->second;
+		}
+		FileEntry &entry = files[fileName];
+		std::ifstream fileStream(fileName, std::ios::in);
+		if (!fileStream.is_open())
+		{
+			printf("File %s not found\n", fileName.c_str());
+			return entry;
+		}
+		std::stringstream buffer;
+		buffer << fileStream.rdbuf();
+		entry.content = buffer.str();
+		entry.found = true;
+		return entry;
+	}
+
+	void resolveIncludes(const std::string &fileName, std::string &output, std::set<std::string> &included, std::set<std::string> &dependencies)
+	{
+		if (!included.insert(fileName).second)
+		{
+			return;
+		}
+		dependencies.insert(fileName);
+		const FileEntry &file = readFile(fileName);
+
+		std::istringstream stream(file.content);
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			size_t start = line.find_first_not_of(" \t");
+			if ((start != std::string::npos) && (line.compare(start, 8, "#include") == 0))
+			{
+				size_t open = line.find('"', start + 8);
+				size_t close = (open != std::string::npos) ? line.find('"', open + 1) : std::string::npos;
+				if (close != std::string::npos)
+				{
+					resolveIncludes(getDirectory(fileName) + line.substr(open + 1, close - open - 1), output, included, dependencies);
+					continue;
+				}
+				printf("%s: malformed #include: %s\n", fileName.c_str(), line.c_str());
+			}
+			output += line;
+			output += "\n";
+		}
+	}
+
+	// Injects the defines after the #version line (or at the top if there is none)
+	static void injectDefines(std::string &source, const std::vector<std::string> &defines)
+	{
+		if (defines.empty())
+		{
+			return;
+		}
+		std::string block;
+		for (auto& define : defines)
+		{
+			size_t separator = define.find('=');
+			if (separator == std::string::npos)
+			{
+				block += "#define " + define + "\n";
+			}
+			else
+			{
+				block += "#define " + define.substr(0, separator) + " " + define.substr(separator + 1) + "\n";
+			}
+		}
+		size_t version = source.find("#version");
+		size_t insertAt = (version == std::string::npos) ? 0 : source.find('\n', version);
+		if (insertAt == std::string::npos)
+		{
+			source += "\n";
+			insertAt = source.size();
+		}
+		else if (version != std::string::npos)
+		{
+			insertAt++;
+		}
+		source.insert(insertAt, block);
+	}
+
+	// Adds the preprocessed stages to the program and collects its dependencies
+	bool addStages(ShaderProgram &program, Registration &registration)
+	{
+		bool result = true;
+		registration.dependencies.clear();
+		for (auto& stage : registration.stages)
+		{
+			std::string source;
+			std::set<std::string> included;
+			resolveIncludes(stage.fileName, source, included, registration.dependencies);
+			injectDefines(source, registration.defines);
+			result &= program.addStage(stage.type, source);
+		}
+
+		std::lock_guard<std::mutex> lock(watchMutex);
+		for (auto& dependency : registration.dependencies)
+		{
+			if (watchedFiles.find(dependency) == watchedFiles.end())
+			{
+				watchedFiles[dependency] = getModificationTime(dependency);
+			}
+		}
+		return result;
+	}
+
+	void watchLoop(uint32_t intervalMs)
+	{
+		while (watching)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+			std::lock_guard<std::mutex> lock(watchMutex);
+			for (auto& file : watchedFiles)
+			{
+				time_t modified = getModificationTime(file.first);
+				if ((modified != 0) && (modified != file.second))
+				{
+					file.second = modified;
+					changedFiles.push_back(file.first);
+				}
+			}
+		}
+	}
+
+public:
+	ShaderSourceManager()
+	{
+		watching = false;
+	}
+
+	~ShaderSourceManager()
+	{
+		stopWatching();
+	}
+
+	// Returns the fully preprocessed source of a single file
+	std::string getSource(const std::string &fileName, const std::vector<std::string> &defines = {})
+	{
+		std::string source;
+		std::set<std::string> included, dependencies;
+		resolveIncludes(fileName, source, included, dependencies);
+		injectDefines(source, defines);
+		return source;
+	}
+
+	// Adds the preprocessed stages to the program and submits it to the compile manager
+	// The program is rebuilt if any of its files change, so it must stay at the same address
+	void addProgram(ShaderProgram &program, const std::vector<ShaderStageFile> &stages, const std::vector<std::string> &defines, ShaderCompileManager &compileManager)
+	{
+		std::unique_ptr<Registration> registration(new Registration());
+		registration->program = &program;
+		registration->stages = stages;
+		registration->defines = defines;
+		addStages(program, *registration);
+		registrations.push_back(std::move(registration));
+		compileManager.add(program);
+	}
+
+	// Returns the variant of a program for the given defines, the variant is created and submitted on first use
+	// Settings (cache, attribute bindings) are taken from the given template program
+	ShaderProgram& getVariant(const ShaderProgram &settings, const std::vector<ShaderStageFile> &stages, const std::vector<std::string> &defines, ShaderCompileManager &compileManager)
+	{
+		std::string key;
+		for (auto& stage : stages)
+		{
+			key += stage.fileName + ";";
+		}
+		for (auto& define : defines)
+		{
+			key += "|" + define;
+		}
+		auto it = variants.find(key);
+		if (it != variants.end())
+		{
+			return *it->second;
+		}
+		ShaderProgram *variant = new ShaderProgram(settings.cloneSettings());
+		variants[key].reset(variant);
+		addProgram(*variant, stages, defines, compileManager);
+		return *variant;
+	}
+
+	// Starts polling the modification times of all dependencies on a background thread
+	void startWatching(uint32_t intervalMs = 500)
+	{
+		if (watching)
+		{
+			return;
+		}
+		watching = true;
+		watcher = std::thread(&ShaderSourceManager::watchLoop, this, intervalMs);
+	}
+
+	void stopWatching()
+	{
+		watching = false;
+		if (watcher.joinable())
+		{
+			watcher.join();
+		}
+	}
+
+	// Call once per frame (after polling the compile manager)
+	// Rebuilds programs that depend on changed files and swaps in reloaded programs that finished compiling
+	void update(ShaderCompileManager &compileManager)
+	{
+		std::vector<std::string> changed;
+		{
+			std::lock_guard<std::mutex> lock(watchMutex);
+			changed.swap(changedFiles);
+		}
+		for (auto& fileName : changed)
+		{
+			printf("Shader file changed: %s\n", fileName.c_str());
+			files.erase(fileName);
+		}
+
+		for (auto& registration : registrations)
+		{
+			// Finished reloads replace the current program, failed ones are dropped and the old program is kept
+			if (registration->staging && !registration->staging->isPending())
+			{
+				if (registration->staging->isLinked())
+				{
+					GLuint oldProgram = registration->program->program;
+					*registration->program = *registration->staging;
+					glDeleteProgram(oldProgram);
+					printf("Program %u reloaded\n", registration->program->program);
+				}
+				else
+				{
+					printf("Reload failed, keeping program %u\n", registration->program->program);
+					registration->staging->destroy();
+				}
+				registration->staging.reset();
+			}
+
+			bool affected = false;
+			for (auto& fileName : changed)
+			{
+				affected |= (registration->dependencies.find(fileName) != registration->dependencies.end());
+			}
+			if (affected)
+			{
+				if (registration->staging)
+				{
+					// A reload is still compiling, wait for it before starting another one
+					compileManager.finishAll();
+					registration->staging->destroy();
+				}
+				registration->staging.reset(new ShaderProgram(registration->program->cloneSettings()));
+				addStages(*registration->staging, *registration);
+				compileManager.add(*registration->staging);
+			}
+		}
+	}
+};
@@ -0,0 +1,702 @@
+/*
+* CPU side reflection of SPIR-V modules (bindings, block layouts, entry points, specialization constants)
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#define SPIRV_MAGIC 0x07230203
+
+// Opcodes and enums used by the parser (from the SPIR-V specification)
+#define SPIRV_OP_NAME 5
+#define SPIRV_OP_MEMBER_NAME 6
+#define SPIRV_OP_ENTRY_POINT 15
+#define SPIRV_OP_EXECUTION_MODE 16
+#define SPIRV_OP_TYPE_BOOL 20
+#define SPIRV_OP_TYPE_INT 21
+#define SPIRV_OP_TYPE_FLOAT 22
+#define SPIRV_OP_TYPE_VECTOR 23
+#define SPIRV_OP_TYPE_MATRIX 24
+#define SPIRV_OP_TYPE_IMAGE 25
+#define SPIRV_OP_TYPE_SAMPLER 26
+#define SPIRV_OP_TYPE_SAMPLED_IMAGE 27
+#define SPIRV_OP_TYPE_ARRAY 28
+#define SPIRV_OP_TYPE_RUNTIME_ARRAY 29
+#define SPIRV_OP_TYPE_STRUCT 30
+#define SPIRV_OP_TYPE_POINTER 32
+#define SPIRV_OP_CONSTANT 43
+#define SPIRV_OP_SPEC_CONSTANT_TRUE 48
+#define SPIRV_OP_SPEC_CONSTANT_FALSE 49
+#define SPIRV_OP_SPEC_CONSTANT 50
+#define SPIRV_OP_VARIABLE 59
+#define SPIRV_OP_DECORATE 71
+#define SPIRV_OP_MEMBER_DECORATE 72
+
+#define SPIRV_DECORATION_SPEC_ID 1
+#define SPIRV_DECORATION_BLOCK 2
+#define SPIRV_DECORATION_BUFFER_BLOCK 3
+#define SPIRV_DECORATION_ARRAY_STRIDE 6
+#define SPIRV_DECORATION_MATRIX_STRIDE 7
+#define SPIRV_DECORATION_BUILTIN 11
+#define SPIRV_DECORATION_LOCATION 30
+#define SPIRV_DECORATION_BINDING 33
+#define SPIRV_DECORATION_DESCRIPTOR_SET 34
+#define SPIRV_DECORATION_OFFSET 35
+
+#define SPIRV_STORAGE_UNIFORM_CONSTANT 0
+#define SPIRV_STORAGE_INPUT 1
+#define SPIRV_STORAGE_UNIFORM 2
+#define SPIRV_STORAGE_OUTPUT 3
+#define SPIRV_STORAGE_STORAGE_BUFFER 12
+
+#define SPIRV_EXECUTION_MODE_LOCAL_SIZE 17
+
+// C++ side of a block member, used to validate host structs against the shader's layout
+struct SpirvHostMember
+{
+	const char *name;
+	size_t offset;
+	size_t size;
+};
+
+#define SPIRV_HOST_MEMBER(type, member) { #member, offsetof(type, member), sizeof(((type*)0)->member) }
+
+// Parses a SPIR-V module without a GL context
+// Extracts uniform/storage blocks with their bindings and member offsets, stage inputs/outputs
+// with their locations, entry points (incl. compute workgroup sizes) and specialization constants
+class SpirvReflection
+{
+public:
+	struct Member
+	{
+		std::string name;
+		std::string typeName;
+		uint32_t offset = 0;
+		// 0 for runtime arrays
+		uint32_t size = 0;
+	};
+
+	struct Block
+	{
+		std::string name;
+		std::string instanceName;
+		uint32_t set = 0;
+		uint32_t binding = 0;
+		// Shader storage block (buffer) or uniform block
+		bool storage = false;
+		uint32_t size = 0;
+		std::vector<Member> members;
+	};
+
+	struct Variable
+	{
+		std::string name;
+		std::string typeName;
+		uint32_t location = 0;
+		uint32_t binding = 0;
+	};
+
+	struct EntryPoint
+	{
+		std::string name;
+		// 0 = vertex, 1 = tessellation control, 2 = tessellation evaluation, 3 = geometry, 4 = fragment, 5 = compute
+		uint32_t executionModel = 0;
+		uint32_t localSize[3] = { 0, 0, 0 };
+	};
+
+	struct SpecConstant
+	{
+		std::string name;
+		std::string typeName;
+		uint32_t specId = 0;
+		uint32_t defaultValue = 0;
+	};
+
+	std::vector<EntryPoint> entryPoints;
+	std::vector<Block> blocks;
+	std::vector<Variable> inputs;
+	std::vector<Variable> outputs;
+	// Samplers, images and other opaque uniforms
+	std::vector<Variable> resources;
+	std::vector<SpecConstant> specConstants;
+
+private:
+	struct Decorations
+	{
+		std::map<uint32_t, uint32_t> values;
+		std::map<uint32_t, std::map<uint32_t, uint32_t>> members;
+	};
+
+	struct Type
+	{
+		uint32_t opcode = 0;
+		std::vector<uint32_t> operands;
+	};
+
+	std::map<uint32_t, std::string> names;
+	std::map<uint32_t, std::map<uint32_t, std::string>> memberNames;
+	std::map<uint32_t, Decorations> decorations;
+	std::map<uint32_t, Type> types;
+	std::map<uint32_t, uint32_t> constants;
+	std::string error;
+
+	// Literal strings are nul terminated and padded to a word boundary
+	static std::string readString(const uint32_t *words, uint32_t wordCount)
+	{
+		std::string result;
+		const char *chars = (const char*)words;
+		size_t maxLength = wordCount * sizeof(uint32_t);
+		size_t length = 0;
+		while ((length < maxLength) && (chars[length] != 0))
+		{
+			length++;
+		}
+		result.assign(chars, length);
+		return result;
+	}
+
+	bool hasDecoration(uint32_t id, uint32_t decoration) const
+	{
+		auto it = decorations.find(id);
+		return (it != decorations.end()) && (it->second.values.find(decoration) != it->second.values.end());
+	}
+
+	uint32_t getDecoration(uint32_t id, uint32_t decoration, uint32_t defaultValue = 0) const
+	{
+		auto it = decorations.find(id);
+		if (it == decorations.end())
+		{
+			return defaultValue;
+		}
+		auto value = it->second.values.find(decoration);
+		return (value != it->second.values.end()) ? value->second : defaultValue;
+	}
+
+	uint32_t getMemberDecoration(uint32_t id, uint32_t member, uint32_t decoration, uint32_t defaultValue = 0) const
+	{
+		auto it = decorations.find(id);
+		if (it == decorations.end())
+		{
+			return defaultValue;
+		}
+		auto memberIt = it->second.members.find(member);
+		if (memberIt == it->second.members.end())
+		{
+			return defaultValue;
+		}
+		auto value = memberIt->second.find(decoration);
+		return (value != memberIt->second.end()) ? value->second : defaultValue;
+	}
+
+	std::string getName(uint32_t id) const
+	{
+		auto it = names.find(id);
+		return (it != names.end()) ? it->second : "";
+	}
+
+	const Type* getType(uint32_t id) const
+	{
+		auto it = types.find(id);
+		return (it != types.end()) ? &it->second : nullptr;
+	}
+
+	// Host side (glm) name of a type
+	std::string getTypeName(uint32_t id) const
+	{
+		const Type *type = getType(id);
+		if (!type)
+		{
+			return "?";
+		}
+		switch (type->opcode)
+		{
+		case SPIRV_OP_TYPE_BOOL:
+			return "bool";
+		case SPIRV_OP_TYPE_INT:
+			return (type->operands[1] != 0) ? "int32_t" : "uint32_t";
+		case SPIRV_OP_TYPE_FLOAT:
+			return (type->operands[0] == 64) ? "double" : "float";
+		case SPIRV_OP_TYPE_VECTOR:
+		{
+			const Type *component = getType(type->operands[0]);
+			std::string prefix = "";
+			if (component && (component->opcode == SPIRV_OP_TYPE_INT))
+			{
+				prefix = (component->operands[1] != 0) ? "i" : "u";
+			}
+			else if (component && (component->opcode == SPIRV_OP_TYPE_FLOAT) && (component->operands[0] == 64))
+			{
+				prefix = "d";
+			}
+			return "glm::" + prefix + "vec" + std::to_string(type->operands[1]);
+		}
+		case SPIRV_OP_TYPE_MATRIX:
+		{
+			const Type *column = getType(type->operands[0]);
+			uint32_t rows = column ? column->operands[1] : 4;
+			uint32_t columns = type->operands[1];
+			return "glm::mat" + std::to_string(columns) + ((rows != columns) ? "x" + std::to_string(rows) : "");
+		}
+		case SPIRV_OP_TYPE_ARRAY:
+		{
+			auto length = constants.find(type->operands[1]);
+			return getTypeName(type->operands[0]) + "[" + ((length != constants.end()) ? std::to_string(length->second) : "?") + "]";
+		}
+		case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+			return getTypeName(type->operands[0]) + "[]";
+		case SPIRV_OP_TYPE_STRUCT:
+			return getName(id);
+		case SPIRV_OP_TYPE_IMAGE:
+			return "image";
+		case SPIRV_OP_TYPE_SAMPLER:
+			return "sampler";
+		case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+			return "sampler2D";
+		default:
+			return "?";
+		}
+	}
+
+	// Size of a type inside a block, strides are taken from the decorations
+	uint32_t getTypeSize(uint32_t id, uint32_t matrixStride = 0) const
+	{
+		const Type *type = getType(id);
+		if (!type)
+		{
+			return 0;
+		}
+		switch (type->opcode)
+		{
+		case SPIRV_OP_TYPE_BOOL:
+			return 4;
+		case SPIRV_OP_TYPE_INT:
+		case SPIRV_OP_TYPE_FLOAT:
+			return type->operands[0] / 8;
+		case SPIRV_OP_TYPE_VECTOR:
+			return getTypeSize(type->operands[0]) * type->operands[1];
+		case SPIRV_OP_TYPE_MATRIX:
+		{
+			uint32_t stride = (matrixStride != 0) ? matrixStride : getTypeSize(type->operands[0]);
+			return stride * type->operands[1];
+		}
+		case SPIRV_OP_TYPE_ARRAY:
+		{
+			auto length = constants.find(type->operands[1]);
+			uint32_t count = (length != constants.end()) ? length->second : 0;
+			uint32_t stride = getDecoration(id, SPIRV_DECORATION_ARRAY_STRIDE, getTypeSize(type->operands[0], matrixStride));
+			return stride * count;
+		}
+		case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+			return 0;
+		case SPIRV_OP_TYPE_STRUCT:
+		{
+			uint32_t size = 0;
+			for (uint32_t i = 0; i < type->operands.size(); i++)
+			{
+				uint32_t offset = getMemberDecoration(id, i, SPIRV_DECORATION_OFFSET);
+				uint32_t memberSize = getTypeSize(type->operands[i], getMemberDecoration(id, i, SPIRV_DECORATION_MATRIX_STRIDE));
+				size = std::max(size, offset + memberSize);
+			}
+			return size;
+		}
+		default:
+			return 0;
+		}
+	}
+
+	void addVariable(uint32_t pointerTypeId, uint32_t id, uint32_t storageClass)
+	{
+		const Type *pointer = getType(pointerTypeId);
+		if (!pointer || (pointer->opcode != SPIRV_OP_TYPE_POINTER))
+		{
+			return;
+		}
+		uint32_t typeId = pointer->operands[1];
+		const Type *type = getType(typeId);
+		// Arrays of blocks are reflected as their element type
+		while (type && ((type->opcode == SPIRV_OP_TYPE_ARRAY) || (type->opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY)) && (storageClass != SPIRV_STORAGE_INPUT) && (storageClass != SPIRV_STORAGE_OUTPUT))
+		{
+			typeId = type->operands[0];
+			type = getType(typeId);
+		}
+		if (!type)
+		{
+			return;
+		}
+
+		if ((storageClass == SPIRV_STORAGE_INPUT) || (storageClass == SPIRV_STORAGE_OUTPUT))
+		{
+			// Built-ins (gl_Position, gl_PerVertex, ...) have no location
+			if (hasDecoration(id, SPIRV_DECORATION_BUILTIN) || !hasDecoration(id, SPIRV_DECORATION_LOCATION))
+			{
+				return;
+			}
+			Variable variable;
+			variable.name = getName(id);
+			variable.typeName = getTypeName(typeId);
+			variable.location = getDecoration(id, SPIRV_DECORATION_LOCATION);
+			((storageClass == SPIRV_STORAGE_INPUT) ? inputs : outputs).push_back(variable);
+			return;
+		}
+
+		if ((type->opcode == SPIRV_OP_TYPE_STRUCT) && ((storageClass == SPIRV_STORAGE_UNIFORM) || (storageClass == SPIRV_STORAGE_STORAGE_BUFFER)))
+		{
+			Block block;
+			block.name = getName(typeId);
+			block.instanceName = getName(id);
+			block.set = getDecoration(id, SPIRV_DECORATION_DESCRIPTOR_SET);
+			block.binding = getDecoration(id, SPIRV_DECORATION_BINDING);
+			block.storage = (storageClass == SPIRV_STORAGE_STORAGE_BUFFER) || hasDecoration(typeId, SPIRV_DECORATION_BUFFER_BLOCK);
+			for (uint32_t i = 0; i < type->operands.size(); i++)
+			{
+				Member member;
+				auto memberName = memberNames.find(typeId);
+				if (memberName != memberNames.end() && (memberName->second.find(i) != memberName->second.end()))
+				{
+					member.name = memberName->second.at(i);
+				}
+				member.typeName = getTypeName(type->operands[i]);
+				member.offset = getMemberDecoration(typeId, i, SPIRV_DECORATION_OFFSET);
+				member.size = getTypeSize(type->operands[i], getMemberDecoration(typeId, i, SPIRV_DECORATION_MATRIX_STRIDE));
+				block.members.push_back(member);
+			}
+			block.size = getTypeSize(typeId);
+			blocks.push_back(block);
+			return;
+		}
+
+		if (storageClass == SPIRV_STORAGE_UNIFORM_CONSTANT)
+		{
+			Variable variable;
+			variable.name = getName(id);
+			variable.typeName = getTypeName(typeId);
+			variable.location = getDecoration(id, SPIRV_DECORATION_LOCATION);
+			variable.binding = getDecoration(id, SPIRV_DECORATION_BINDING);
+			resources.push_back(variable);
+		}
+	}
+
+public:
+	// Returns false if the module is malformed, see getError()
+	bool parse(const uint32_t *code, size_t wordCount)
+	{
+		*this = SpirvReflection();
+		if ((wordCount < 5) || (code[0] != SPIRV_MAGIC))
+		{
+			error = "not a SPIR-V module";
+			return false;
+		}
+
+		// Variables are resolved after all types and decorations have been read
+		struct VariableRef
+		{
+			uint32_t type, id, storageClass;
+		};
+		std::vector<VariableRef> variables;
+		// Specialization constants are resolved the same way, as the SpecId decoration comes first but the type may not be known yet
+		struct ConstantRef
+		{
+			uint32_t type, id, value;
+		};
+		std::vector<ConstantRef> specConstantRefs;
+		std::map<uint32_t, size_t> entryPointIds;
+
+		size_t pos = 5;
+		while (pos < wordCount)
+		{
+			uint32_t opcode = code[pos] & 0xFFFF;
+			uint32_t length = code[pos] >> 16;
+			if ((length == 0) || (pos + length > wordCount))
+			{
+				error = "malformed instruction at word " + std::to_string(pos);
+				return false;
+			}
+			const uint32_t *ops = &code[pos + 1];
+			uint32_t opCount = length - 1;
+
+			switch (opcode)
+			{
+			case SPIRV_OP_NAME:
+				if (opCount >= 2)
+				{
+					names[ops[0]] = readString(&ops[1], opCount - 1);
+				}
+				break;
+			case SPIRV_OP_MEMBER_NAME:
+				if (opCount >= 3)
+				{
+					memberNames[ops[0]][ops[1]] = readString(&ops[2], opCount - 2);
+				}
+				break;
+			case SPIRV_OP_ENTRY_POINT:
+				if (opCount >= 3)
+				{
+					EntryPoint entryPoint;
+					entryPoint.executionModel = ops[0];
+					entryPoint.name = readString(&ops[2], opCount - 2);
+					entryPointIds[ops[1]] = entryPoints.size();
+					entryPoints.push_back(entryPoint);
+				}
+				break;
+			case SPIRV_OP_EXECUTION_MODE:
+				if ((opCount >= 5) && (ops[1] == SPIRV_EXECUTION_MODE_LOCAL_SIZE))
+				{
+					auto it = entryPointIds.find(ops[0]);
+					if (it != entryPointIds.end())
+					{
+						for (uint32_t i = 0; i < 3; i++)
+						{
+							entryPoints[it->second].localSize[i] = ops[2 + i];
+						}
+					}
+				}
+				break;
+			case SPIRV_OP_DECORATE:
+				if (opCount >= 2)
+				{
+					decorations[ops[0]].values[ops[1]] = (opCount >= 3) ? ops[2] : 0;
+				}
+				break;
+			case SPIRV_OP_MEMBER_DECORATE:
+				if (opCount >= 3)
+				{
+					decorations[ops[0]].members[ops[1]][ops[2]] = (opCount >= 4) ? ops[3] : 0;
+				}
+				break;
+			case SPIRV_OP_TYPE_BOOL:
+			case SPIRV_OP_TYPE_INT:
+			case SPIRV_OP_TYPE_FLOAT:
+			case SPIRV_OP_TYPE_VECTOR:
+			case SPIRV_OP_TYPE_MATRIX:
+			case SPIRV_OP_TYPE_IMAGE:
+			case SPIRV_OP_TYPE_SAMPLER:
+			case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+			case SPIRV_OP_TYPE_ARRAY:
+			case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+			case SPIRV_OP_TYPE_STRUCT:
+			case SPIRV_OP_TYPE_POINTER:
+				if (opCount >= 1)
+				{
+					Type &type = types[ops[0]];
+					type.opcode = opcode;
+					type.operands.assign(ops + 1, ops + opCount);
+					// Pad operands so lookups of fixed operands (width, signedness, count) are always valid
+					// Structs use the operand count as the member count
+					while ((opcode != SPIRV_OP_TYPE_STRUCT) && (type.operands.size() < 2))
+					{
+						type.operands.push_back(0);
+					}
+				}
+				break;
+			case SPIRV_OP_CONSTANT:
+			case SPIRV_OP_SPEC_CONSTANT:
+				// Array lengths given by specialization constants are reported with their default value
+				if (opCount >= 3)
+				{
+					constants[ops[1]] = ops[2];
+					if (opcode == SPIRV_OP_SPEC_CONSTANT)
+					{
+						specConstantRefs.push_back({ ops[0], ops[1], ops[2] });
+					}
+				}
+				break;
+			case SPIRV_OP_SPEC_CONSTANT_TRUE:
+			case SPIRV_OP_SPEC_CONSTANT_FALSE:
+				if (opCount >= 2)
+				{
+					uint32_t value = (opcode == SPIRV_OP_SPEC_CONSTANT_TRUE) ? 1 : 0;
+					constants[ops[1]] = value;
+					specConstantRefs.push_back({ ops[0], ops[1], value });
+				}
+				break;
+			case SPIRV_OP_VARIABLE:
+				if (opCount >= 3)
+				{
+					variables.push_back({ ops[0], ops[1], ops[2] });
+				}
+				break;
+			}
+			pos += length;
+		}
+
+		for (auto& ref : specConstantRefs)
+		{
+			// Spec constants without a SpecId can't be set by the application
+			if (!hasDecoration(ref.id, SPIRV_DECORATION_SPEC_ID))
+			{
+				continue;
+			}
+			SpecConstant constant;
+			constant.name = getName(ref.id);
+			constant.typeName = getTypeName(ref.type);
+			constant.specId = getDecoration(ref.id, SPIRV_DECORATION_SPEC_ID);
+			constant.defaultValue = ref.value;
+			specConstants.push_back(constant);
+		}
+
+		for (auto& variable : variables)
+		{
+			addVariable(variable.type, variable.id, variable.storageClass);
+		}
+		return true;
+	}
+
+	bool parse(const std::vector<uint32_t> &code)
+	{
+		return parse(code.data(), code.size());
+	}
+
+	const std::string& getError() const
+	{
+		return error;
+	}
+
+	const Block* findBlock(uint32_t binding, bool storage = false) const
+	{
+		for (auto& block : blocks)
+		{
+			if ((block.binding == binding) && (block.storage == storage))
+			{
+				return &block;
+			}
+		}
+		return nullptr;
+	}
+
+	const Block* findBlock(const std::string &name) const
+	{
+		for (auto& block : blocks)
+		{
+			if ((block.name == name) || (block.instanceName == name))
+			{
+				return &block;
+			}
+		}
+		return nullptr;
+	}
+
+	// Returns -1 if there is no input with that name
+	int32_t getInputLocation(const std::string &name) const
+	{
+		for (auto& input : inputs)
+		{
+			if (input.name == name)
+			{
+				return (int32_t)input.location;
+			}
+		}
+		return -1;
+	}
+
+	// Generates a host struct declaration matching the block's layout, padding is made explicit
+	std::string generateStruct(const Block &block) const
+	{
+		std::string result = "struct " + (block.name.empty() ? std::string("Block") : block.name) + "\n{\n";
+		uint32_t offset = 0;
+		uint32_t padding = 0;
+		for (size_t i = 0; i < block.members.size(); i++)
+		{
+			const Member &member = block.members[i];
+			if (member.offset > offset)
+			{
+				result += "\tuint8_t _pad" + std::to_string(padding++) + "[" + std::to_string(member.offset - offset) + "];\n";
+			}
+			std::string typeName = member.typeName;
+			std::string arraySuffix = "";
+			size_t bracket = typeName.find('[');
+			if (bracket != std::string::npos)
+			{
+				arraySuffix = typeName.substr(bracket);
+				typeName = typeName.substr(0, bracket);
+			}
+			std::string name = member.name.empty() ? "member" + std::to_string(i) : member.name;
+			result += "\t" + typeName + " " + name + arraySuffix + "; // offset " + std::to_string(member.offset) + ", size " + std::to_string(member.size) + "\n";
+			offset = member.offset + member.size;
+		}
+		result += "};\n";
+		return result;
+	}
+
+	// Compares a host struct against a block's layout, members are matched by declaration order
+	// Prints all mismatches and returns false if there are any
+	bool validateBlock(const Block &block, size_t hostSize, const std::vector<SpirvHostMember> &hostMembers) const
+	{
+		bool valid = true;
+		if (hostMembers.size() != block.members.size())
+		{
+			printf("Block \"%s\": host struct has %zu members, shader has %zu\n", block.name.c_str(), hostMembers.size(), block.members.size());
+			valid = false;
+		}
+		for (size_t i = 0; i < std::min(hostMembers.size(), block.members.size()); i++)
+		{
+			const Member &member = block.members[i];
+			const SpirvHostMember &host = hostMembers[i];
+			if (host.offset != member.offset)
+			{
+				printf("Block \"%s\": member %zu (%s / %s) at offset %zu on the host, %u in the shader\n", block.name.c_str(), i, host.name, member.name.c_str(), host.offset, member.offset);
+				valid = false;
+			}
+			// Runtime arrays have no size in the shader
+			if ((member.size != 0) && (host.size != member.size))
+			{
+				printf("Block \"%s\": member %zu (%s / %s) has %zu bytes on the host, %u in the shader\n", block.name.c_str(), i, host.name, member.name.c_str(), host.size, member.size);
+				valid = false;
+			}
+		}
+		if (hostSize < block.size)
+		{
+			printf("Block \"%s\": host struct has %zu bytes, shader requires %u\n", block.name.c_str(), hostSize, block.size);
+			valid = false;
+		}
+		return valid;
+	}
+
+	void printReport() const
+	{
+		static const char *models[] = { "vertex", "tessellation control", "tessellation evaluation", "geometry", "fragment", "compute" };
+		for (auto& entryPoint : entryPoints)
+		{
+			printf("Entry point \"%s\" (%s)", entryPoint.name.c_str(), (entryPoint.executionModel < 6) ? models[entryPoint.executionModel] : "other");
+			if (entryPoint.executionModel == 5)
+			{
+				printf(", local size %u x %u x %u", entryPoint.localSize[0], entryPoint.localSize[1], entryPoint.localSize[2]);
+			}
+			printf("\n");
+		}
+		for (auto& input : inputs)
+		{
+			printf("  in  location %u: %s %s\n", input.location, input.typeName.c_str(), input.name.c_str());
+		}
+		for (auto& output : outputs)
+		{
+			printf("  out location %u: %s %s\n", output.location, output.typeName.c_str(), output.name.c_str());
+		}
+		for (auto& block : blocks)
+		{
+			printf("  %s block \"%s\" (set %u, binding %u, %u bytes)\n", block.storage ? "storage" : "uniform", block.name.c_str(), block.set, block.binding, block.size);
+			for (auto& member : block.members)
+			{
+				printf("    %4u: %s %s (%u bytes)\n", member.offset, member.typeName.c_str(), member.name.c_str(), member.size);
+			}
+		}
+		for (auto& resource : resources)
+		{
+			printf("  %s \"%s\" (binding %u)\n", resource.typeName.c_str(), resource.name.c_str(), resource.binding);
+		}
+		for (auto& constant : specConstants)
+		{
+			printf("  specialization constant %u: %s %s = %u\n", constant.specId, constant.typeName.c_str(), constant.name.c_str(), constant.defaultValue);
+		}
+	}
+};
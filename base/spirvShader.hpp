@@ -0,0 +1,110 @@
+/*
+* Loading SPIR-V shader binaries with specialization constants (GL_ARB_gl_spirv)
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#include <GL/glew.h>
+
+// Specialization constant ids and values passed to glSpecializeShaderARB
+// Values are always passed as 32 bit words, booleans as 0/1
+struct SpecializationConstants
+{
+	std::vector<GLuint> ids;
+	std::vector<GLuint> values;
+
+	void set(GLuint id, uint32_t value)
+	{
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			if (ids[i] == id)
+			{
+				values[i] = value;
+				return;
+			}
+		}
+		ids.push_back(id);
+		values.push_back(value);
+	}
+
+	void set(GLuint id, int32_t value)
+	{
+		set(id, (uint32_t)value);
+	}
+
+	void set(GLuint id, float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		set(id, bits);
+	}
+
+	void set(GLuint id, bool value)
+	{
+		set(id, (uint32_t)(value ? 1 : 0));
+	}
+
+	bool empty() const
+	{
+		return ids.empty();
+	}
+};
+
+// Reads a SPIR-V binary, returns false if the file doesn't exist or isn't a SPIR-V module
+inline bool readSpirvFile(const char *fileName, std::vector<uint32_t> &code)
+{
+	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	size_t size = (size_t)file.tellg();
+	file.seekg(0, std::ios::beg);
+	code.resize(size / sizeof(uint32_t));
+	file.read((char*)code.data(), code.size() * sizeof(uint32_t));
+	// Magic number
+	if ((size % 4 != 0) || code.empty() || (code[0] != 0x07230203))
+	{
+		std::cerr << "\"" << fileName << "\" is not a valid SPIR-V binary" << std::endl;
+		code.clear();
+		return false;
+	}
+	return true;
+}
+
+// Creates a shader object from a SPIR-V module and specializes the given entry point
+// Returns 0 if specialization failed
+inline GLuint loadSpirvStage(GLenum stage, const std::vector<uint32_t> &code, const char *entryPoint, const SpecializationConstants &constants)
+{
+	GLuint shader = glCreateShader(stage);
+	glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, code.data(), (GLsizei)(code.size() * sizeof(uint32_t)));
+	glSpecializeShaderARB(shader, entryPoint, (GLuint)constants.ids.size(), constants.ids.data(), constants.values.data());
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		GLint logLength = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+		if (logLength > 1)
+		{
+			std::vector<GLchar> log(logLength + 1);
+			glGetShaderInfoLog(shader, logLength, NULL, log.data());
+			printf("shaderlog: %s\n", log.data());
+		}
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
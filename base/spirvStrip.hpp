@@ -0,0 +1,495 @@
+/*
+* SPIR-V module stripping (debug instructions, dead functions, unused types and constants) and id compaction
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+
+#define SPIRV_STRIP_MAGIC 0x07230203
+#define SPIRV_STRIP_HEADER_SIZE 5
+
+// Flags for SpirvStripper::strip()
+#define SPIRV_STRIP_DEBUG 0x1
+#define SPIRV_STRIP_DEAD_FUNCTIONS 0x2
+#define SPIRV_STRIP_DEAD_GLOBALS 0x4
+#define SPIRV_STRIP_COMPACT_IDS 0x8
+#define SPIRV_STRIP_ALL 0xF
+
+// Removes everything a driver doesn't need from a SPIR-V module to make it smaller and faster to ingest:
+// - Debug instructions (OpName, OpMemberName, OpSource*, OpString, OpLine, OpNoLine, OpModuleProcessed)
+// - Functions that can't be reached from an entry point
+// - Types, constants and global variables that are no longer referenced (and their decorations)
+// - Ids are renumbered densely in order of appearance, which lowers the id bound
+// Operands are identified with a per opcode operand table, modules containing opcodes not in the table
+// are still stripped, but ids are not compacted (unknown operands are conservatively treated as references)
+// Note: Names are required for reflection, reflect before stripping
+class SpirvStripper
+{
+public:
+	struct Stats
+	{
+		size_t originalBytes = 0;
+		size_t strippedBytes = 0;
+		uint32_t debugInstructions = 0;
+		uint32_t functions = 0;
+		uint32_t globals = 0;
+		uint32_t originalIdBound = 0;
+		uint32_t idBound = 0;
+		bool compacted = false;
+		// Opcode that prevented id compaction, 0 if none
+		uint32_t unknownOpcode = 0;
+		double time = 0.0;
+	};
+
+private:
+	struct Instruction
+	{
+		uint32_t opcode;
+		size_t offset;
+		uint32_t length;
+		bool removed;
+	};
+
+	// Operand layout after the opcode word:
+	// i = id, l = literal word, s = literal string, p = literal + id pair, * = the next kind repeats until the end
+	// Operands missing at the end are optional
+	static const char* getOperandLayout(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case 0: return "";															// OpNop
+		case 1: return "ii";														// OpUndef
+		case 2: return "s";															// OpSourceContinued
+		case 3: return "llis";														// OpSource
+		case 4: return "s";															// OpSourceExtension
+		case 5: return "is";														// OpName
+		case 6: return "ils";														// OpMemberName
+		case 7: return "is";														// OpString
+		case 8: return "ill";														// OpLine
+		case 10: return "s";														// OpExtension
+		case 11: return "is";														// OpExtInstImport
+		case 12: return "iiil*i";													// OpExtInst
+		case 14: return "ll";														// OpMemoryModel
+		case 15: return "lis*i";													// OpEntryPoint
+		case 16: return "il*l";														// OpExecutionMode
+		case 17: return "l";														// OpCapability
+		case 19: case 20: case 26: return "i";										// OpTypeVoid, OpTypeBool, OpTypeSampler
+		case 21: return "ill";														// OpTypeInt
+		case 22: return "il";														// OpTypeFloat
+		case 23: case 24: return "iil";												// OpTypeVector, OpTypeMatrix
+		case 25: return "iil*l";													// OpTypeImage
+		case 27: case 29: return "ii";												// OpTypeSampledImage, OpTypeRuntimeArray
+		case 28: return "iii";														// OpTypeArray
+		case 30: return "i*i";														// OpTypeStruct
+		case 32: return "ili";														// OpTypePointer
+		case 33: return "ii*i";														// OpTypeFunction
+		case 39: return "il";														// OpTypeForwardPointer
+		case 41: case 42: case 46: case 48: case 49: return "ii";					// OpConstantTrue/False/Null, OpSpecConstantTrue/False
+		case 43: case 50: return "ii*l";											// OpConstant, OpSpecConstant
+		case 44: case 51: return "ii*i";											// OpConstantComposite, OpSpecConstantComposite
+		case 52: return "iil*i";													// OpSpecConstantOp
+		case 54: return "iili";														// OpFunction
+		case 55: return "ii";														// OpFunctionParameter
+		case 56: return "";															// OpFunctionEnd
+		case 57: return "iii*i";													// OpFunctionCall
+		case 59: return "iili";														// OpVariable
+		case 61: return "iii*l";													// OpLoad
+		case 62: case 63: return "ii*l";											// OpStore, OpCopyMemory
+		case 65: case 66: return "iii*i";											// OpAccessChain, OpInBoundsAccessChain
+		case 68: return "iiil";														// OpArrayLength
+		case 71: return "il*l";														// OpDecorate
+		case 72: return "ill*l";													// OpMemberDecorate
+		case 77: return "iiii";														// OpVectorExtractDynamic
+		case 78: return "iiiii";													// OpVectorInsertDynamic
+		case 79: return "iiii*l";													// OpVectorShuffle
+		case 80: return "ii*i";														// OpCompositeConstruct
+		case 81: return "iii*l";													// OpCompositeExtract
+		case 82: return "iiii*l";													// OpCompositeInsert
+		case 83: case 84: return "iii";												// OpCopyObject, OpTranspose
+		case 86: return "iiii";														// OpSampledImage
+		case 87: case 88: case 95: case 98: return "iiiil*i";						// OpImageSample(Im|Ex)plicitLod, OpImageFetch, OpImageRead
+		case 89: case 90: case 96: case 97: return "iiiiil*i";						// OpImageSampleDref*, OpImageGather, OpImageDrefGather
+		case 99: return "iiil*i";													// OpImageWrite
+		case 100: case 104: case 106: case 107: return "iii";						// OpImage, OpImageQuerySize, OpImageQueryLevels, OpImageQuerySamples
+		case 103: case 105: return "iiii";											// OpImageQuerySizeLod, OpImageQueryLod
+		case 200: case 204: case 205: return "iii";									// OpNot, OpBitReverse, OpBitCount
+		case 201: return "iiiiii";													// OpBitFieldInsert
+		case 202: case 203: return "iiiii";											// OpBitField(S|U)Extract
+		case 169: return "iiiii";													// OpSelect
+		case 218: case 219: case 252: case 253: case 255: return "";				// OpEmitVertex, OpEndPrimitive, OpKill, OpReturn, OpUnreachable
+		case 224: return "iii";														// OpControlBarrier
+		case 225: return "ii";														// OpMemoryBarrier
+		case 227: case 232: case 233: return "iiiii";								// OpAtomicLoad, OpAtomicIIncrement/IDecrement
+		case 228: return "iiii";													// OpAtomicStore
+		case 230: return "iiiiiiii";												// OpAtomicCompareExchange
+		case 245: return "ii*i";													// OpPhi
+		case 246: return "iil*l";													// OpLoopMerge
+		case 247: return "il";														// OpSelectionMerge
+		case 248: case 249: case 254: return "i";									// OpLabel, OpBranch, OpReturnValue
+		case 250: return "iii*l";													// OpBranchConditional
+		case 251: return "ii*p";													// OpSwitch (32 bit selectors only)
+		case 317: return "";														// OpNoLine
+		case 330: return "s";														// OpModuleProcessed
+		case 331: case 332: return "il*i";											// OpExecutionModeId, OpDecorateId
+		}
+		// Conversions, arithmetic, relational and derivative instructions share the same layouts
+		if ((opcode >= 109) && (opcode <= 124)) return "iii";						// OpConvert*, OpBitcast
+		if ((opcode == 126) || (opcode == 127)) return "iii";						// OpSNegate, OpFNegate
+		if ((opcode >= 128) && (opcode <= 148)) return "iiii";						// OpIAdd .. OpDot
+		if ((opcode >= 154) && (opcode <= 157)) return "iii";						// OpAny, OpAll, OpIsNan, OpIsInf
+		if ((opcode >= 164) && (opcode <= 167)) return "iiii";						// OpLogical(Not)Equal, OpLogicalOr/And
+		if (opcode == 168) return "iii";											// OpLogicalNot
+		if ((opcode >= 170) && (opcode <= 199)) return "iiii";						// Comparisons, shifts, bitwise ops
+		if ((opcode >= 207) && (opcode <= 215)) return "iii";						// OpDPdx .. OpFwidthCoarse
+		if ((opcode == 229) || ((opcode >= 234) && (opcode <= 242))) return "iiiiii";	// OpAtomicExchange, OpAtomicIAdd .. OpAtomicXor
+		return nullptr;
+	}
+
+	static bool isDebugInstruction(uint32_t opcode)
+	{
+		return ((opcode >= 2) && (opcode <= 8)) || (opcode == 317) || (opcode == 330);
+	}
+
+	// Types, constants and global variables that can be removed when nothing references them
+	static bool isRemovableGlobal(uint32_t opcode)
+	{
+		return (opcode == 1) || ((opcode >= 19) && (opcode <= 39)) || ((opcode >= 41) && (opcode <= 52)) || (opcode == 59);
+	}
+
+	static bool isDecoration(uint32_t opcode)
+	{
+		return (opcode == 5) || (opcode == 6) || (opcode == 71) || (opcode == 72) || (opcode == 332);
+	}
+
+	// Calls the function for every id operand (including result ids) of an instruction
+	// Returns false if the opcode isn't in the table, all operands are passed as ids in that case
+	template <typename F>
+	static bool forEachId(std::vector<uint32_t> &words, const Instruction &instruction, F function)
+	{
+		const char *layout = getOperandLayout(instruction.opcode);
+		size_t pos = instruction.offset + 1;
+		size_t end = instruction.offset + instruction.length;
+		if (!layout)
+		{
+			for (; pos < end; pos++)
+			{
+				function(words[pos]);
+			}
+			return false;
+		}
+		const char *kind = layout;
+		while ((pos < end) && (*kind != 0))
+		{
+			bool repeat = (*kind == '*');
+			char current = repeat ? kind[1] : *kind;
+			switch (current)
+			{
+			case 'i':
+				function(words[pos++]);
+				break;
+			case 'l':
+				pos++;
+				break;
+			case 's':
+				// Nul terminated, padded to a word boundary
+				while ((pos < end) && ((words[pos] & 0xFF000000) != 0))
+				{
+					pos++;
+				}
+				pos++;
+				break;
+			case 'p':
+				pos++;
+				if (pos < end)
+				{
+					function(words[pos++]);
+				}
+				break;
+			}
+			if (!repeat)
+			{
+				kind++;
+			}
+		}
+		return true;
+	}
+
+	// Returns 0 for instructions without a result
+	static uint32_t getResultId(const std::vector<uint32_t> &words, const Instruction &instruction)
+	{
+		switch (instruction.opcode)
+		{
+		case 0: case 2: case 3: case 4: case 5: case 6: case 8: case 10: case 14: case 15: case 16: case 17:
+		case 56: case 62: case 63: case 71: case 72: case 74: case 75: case 99: case 218: case 219: case 224: case 225: case 228:
+		case 246: case 247: case 249: case 250: case 251: case 252: case 253: case 254: case 255: case 317: case 330: case 331: case 332:
+			return 0;
+		case 7: case 11: case 73: case 248:
+			return (instruction.length >= 2) ? words[instruction.offset + 1] : 0;
+		}
+		if ((instruction.opcode >= 19) && (instruction.opcode <= 39))
+		{
+			return (instruction.length >= 2) ? words[instruction.offset + 1] : 0;
+		}
+		// Result type followed by the result id
+		return (instruction.length >= 3) ? words[instruction.offset + 2] : 0;
+	}
+
+	// Names and decorations of ids that are no longer defined
+	static void removeOrphanedDecorations(const std::vector<uint32_t> &words, std::vector<Instruction> &instructions)
+	{
+		std::set<uint32_t> defined;
+		for (auto& instruction : instructions)
+		{
+			if (!instruction.removed)
+			{
+				defined.insert(getResultId(words, instruction));
+			}
+		}
+		for (auto& instruction : instructions)
+		{
+			if (!instruction.removed && isDecoration(instruction.opcode) && (defined.find(words[instruction.offset + 1]) == defined.end()))
+			{
+				instruction.removed = true;
+			}
+		}
+	}
+
+	static void removeDeadFunctions(std::vector<uint32_t> &words, std::vector<Instruction> &instructions, Stats &stats)
+	{
+		// Function id -> range of instructions
+		std::map<uint32_t, std::pair<size_t, size_t>> functions;
+		std::vector<uint32_t> pending;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			const Instruction &instruction = instructions[i];
+			if (instruction.opcode == 15)
+			{
+				pending.push_back(words[instruction.offset + 2]);
+			}
+			if (instruction.opcode == 54)
+			{
+				size_t end = i;
+				while ((end < instructions.size()) && (instructions[end].opcode != 56))
+				{
+					end++;
+				}
+				functions[words[instruction.offset + 2]] = std::make_pair(i, end);
+				i = end;
+			}
+		}
+
+		std::set<uint32_t> reachable;
+		while (!pending.empty())
+		{
+			uint32_t id = pending.back();
+			pending.pop_back();
+			auto function = functions.find(id);
+			if ((function == functions.end()) || !reachable.insert(id).second)
+			{
+				continue;
+			}
+			for (size_t i = function->second.first; i <= function->second.second && i < instructions.size(); i++)
+			{
+				if (instructions[i].opcode == 57)
+				{
+					pending.push_back(words[instructions[i].offset + 3]);
+				}
+			}
+		}
+
+		for (auto& function : functions)
+		{
+			if (reachable.find(function.first) != reachable.end())
+			{
+				continue;
+			}
+			stats.functions++;
+			for (size_t i = function.second.first; i <= function.second.second && i < instructions.size(); i++)
+			{
+				instructions[i].removed = true;
+			}
+		}
+	}
+
+	static void removeDeadGlobals(std::vector<uint32_t> &words, std::vector<Instruction> &instructions, Stats &stats)
+	{
+		// Decoration groups apply decorations indirectly, leave such modules alone
+		for (auto& instruction : instructions)
+		{
+			if ((instruction.opcode == 73) && !instruction.removed)
+			{
+				return;
+			}
+		}
+
+		std::map<uint32_t, size_t> definitions;
+		for (size_t i = 0; i < instructions.size(); i++)
+		{
+			if (!instructions[i].removed && isRemovableGlobal(instructions[i].opcode))
+			{
+				definitions[getResultId(words, instructions[i])] = i;
+			}
+		}
+
+		// Everything that's not a removable global or a decoration is a root
+		std::set<uint32_t> live;
+		std::vector<uint32_t> pending;
+		auto reference = [&](uint32_t id)
+		{
+			if (live.insert(id).second)
+			{
+				pending.push_back(id);
+			}
+		};
+		for (auto& instruction : instructions)
+		{
+			if (!instruction.removed && !isRemovableGlobal(instruction.opcode) && !isDecoration(instruction.opcode))
+			{
+				forEachId(words, instruction, reference);
+			}
+		}
+		while (!pending.empty())
+		{
+			uint32_t id = pending.back();
+			pending.pop_back();
+			auto definition = definitions.find(id);
+			if (definition != definitions.end())
+			{
+				forEachId(words, instructions[definition->second], reference);
+			}
+		}
+
+		for (auto& definition : definitions)
+		{
+			if (live.find(definition.first) == live.end())
+			{
+				instructions[definition.second].removed = true;
+				stats.globals++;
+			}
+		}
+	}
+
+public:
+	// Strips the module in place, returns false if it isn't a valid SPIR-V module (it's left unchanged then)
+	static bool strip(std::vector<uint32_t> &words, uint32_t flags = SPIRV_STRIP_ALL, Stats *statsOut = nullptr)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		Stats stats;
+		stats.originalBytes = words.size() * sizeof(uint32_t);
+		if ((words.size() < SPIRV_STRIP_HEADER_SIZE) || (words[0] != SPIRV_STRIP_MAGIC))
+		{
+			return false;
+		}
+		stats.originalIdBound = words[3];
+
+		std::vector<Instruction> instructions;
+		for (size_t pos = SPIRV_STRIP_HEADER_SIZE; pos < words.size(); )
+		{
+			Instruction instruction;
+			instruction.opcode = words[pos] & 0xFFFF;
+			instruction.length = words[pos] >> 16;
+			instruction.offset = pos;
+			instruction.removed = false;
+			if ((instruction.length == 0) || (pos + instruction.length > words.size()))
+			{
+				return false;
+			}
+			if ((flags & SPIRV_STRIP_DEBUG) && isDebugInstruction(instruction.opcode))
+			{
+				instruction.removed = true;
+				stats.debugInstructions++;
+			}
+			instructions.push_back(instruction);
+			pos += instruction.length;
+		}
+
+		if (flags & SPIRV_STRIP_DEAD_FUNCTIONS)
+		{
+			removeDeadFunctions(words, instructions, stats);
+		}
+		if (flags & SPIRV_STRIP_DEAD_GLOBALS)
+		{
+			removeDeadGlobals(words, instructions, stats);
+		}
+		removeOrphanedDecorations(words, instructions);
+
+		std::vector<uint32_t> output(words.begin(), words.begin() + SPIRV_STRIP_HEADER_SIZE);
+		output.reserve(words.size());
+		for (auto& instruction : instructions)
+		{
+			if (!instruction.removed)
+			{
+				output.insert(output.end(), words.begin() + instruction.offset, words.begin() + instruction.offset + instruction.length);
+			}
+		}
+
+		if (flags & SPIRV_STRIP_COMPACT_IDS)
+		{
+			// Check all opcodes first, a partially renumbered module would be invalid
+			std::vector<Instruction> remaining;
+			for (size_t pos = SPIRV_STRIP_HEADER_SIZE; pos < output.size(); pos += output[pos] >> 16)
+			{
+				Instruction instruction = { output[pos] & 0xFFFF, pos, output[pos] >> 16, false };
+				if (!getOperandLayout(instruction.opcode) && (stats.unknownOpcode == 0))
+				{
+					stats.unknownOpcode = instruction.opcode;
+				}
+				remaining.push_back(instruction);
+			}
+			if (stats.unknownOpcode == 0)
+			{
+				std::vector<uint32_t> remap(output[3], 0);
+				uint32_t nextId = 1;
+				auto renumber = [&](uint32_t &id)
+				{
+					if (id >= remap.size())
+					{
+						return;
+					}
+					if (remap[id] == 0)
+					{
+						remap[id] = nextId++;
+					}
+					id = remap[id];
+				};
+				for (auto& instruction : remaining)
+				{
+					forEachId(output, instruction, renumber);
+				}
+				output[3] = nextId;
+				stats.compacted = true;
+			}
+		}
+
+		stats.idBound = output[3];
+		stats.strippedBytes = output.size() * sizeof(uint32_t);
+		stats.time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		words.swap(output);
+		if (statsOut)
+		{
+			*statsOut = stats;
+		}
+		return true;
+	}
+
+	static void printStats(const char *name, const Stats &stats)
+	{
+		printf("%s: %zu -> %zu bytes (%.1f%%), removed %u debug instructions, %u functions, %u types/constants/variables, id bound %u -> %u", name, stats.originalBytes, stats.strippedBytes,
+			(stats.originalBytes > 0) ? 100.0 * (double)stats.strippedBytes / (double)stats.originalBytes : 0.0, stats.debugInstructions, stats.functions, stats.globals, stats.originalIdBound, stats.idBound);
+		if (stats.unknownOpcode != 0)
+		{
+			printf(" (not compacted, unknown opcode %u)", stats.unknownOpcode);
+		}
+		printf(", %.3f ms\n", stats.time);
+	}
+};
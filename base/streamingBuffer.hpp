@@ -0,0 +1,196 @@
+/*
+* Persistently mapped ring buffer for streaming per frame data (uniforms, etc.)
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// One immutable buffer (glBufferStorage) that stays mapped for its whole lifetime
+// The buffer is split into regionCount regions, one per frame in flight
+// Each frame sub-allocates from its region, and a fence is inserted when the frame is done
+// Before a region is reused, the cpu waits on its fence, so data still read by the gpu is never overwritten
+// Note: No destructor, call destroy() while the context is still current
+class StreamingBuffer
+{
+private:
+	GLuint buffer = 0;
+	GLenum target = GL_UNIFORM_BUFFER;
+	uint8_t *mapped = nullptr;
+	GLsizeiptr regionSize = 0;
+	uint32_t regionCount = 0;
+	uint32_t currentRegion = 0;
+	// Offset of the next free byte inside the current region
+	GLsizeiptr regionOffset = 0;
+	GLsizeiptr alignment = 1;
+	std::vector<GLsync> fences;
+
+	// Blocks until the gpu has finished reading from the given region
+	void waitForRegion(uint32_t region)
+	{
+		GLsync fence = fences[region];
+		if (fence == 0)
+		{
+			return;
+		}
+		// Poll first, only count a wait if the fence hasn't been signaled yet
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if ((result == GL_TIMEOUT_EXPIRED) || (result == GL_WAIT_FAILED))
+		{
+			stats.fenceWaits++;
+			double waitStart = glfwGetTime();
+			do
+			{
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (result == GL_TIMEOUT_EXPIRED);
+			stats.waitTime += glfwGetTime() - waitStart;
+		}
+		glDeleteSync(fence);
+		fences[region] = 0;
+	}
+
+	void advance()
+	{
+		fences[currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		currentRegion = (currentRegion + 1) % regionCount;
+		regionOffset = 0;
+		waitForRegion(currentRegion);
+	}
+
+public:
+	// Sub allocation inside the current frame's region
+	struct Allocation
+	{
+		void *pointer = nullptr;
+		// Offset from the start of the buffer
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+	};
+
+	struct Stats
+	{
+		uint64_t frames = 0;
+		// Number of times the cpu had to block on a fence before reusing a region
+		uint64_t fenceWaits = 0;
+		// Total time spent waiting on fences in seconds
+		double waitTime = 0.0;
+		// Number of times a frame ran out of space in its region
+		uint64_t overflows = 0;
+		// Bytes allocated in the last completed frame
+		GLsizeiptr frameBytes = 0;
+	} stats;
+
+	// Requires immutable buffer storage (OpenGL 4.4 or GL_ARB_buffer_storage)
+	static bool isSupported()
+	{
+		return (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage);
+	}
+
+	// regionSize = max. number of bytes allocated per frame (before alignment)
+	void create(GLenum target, GLsizeiptr regionSize, uint32_t regionCount = 3)
+	{
+		this->target = target;
+		this->regionCount = std::max(regionCount, 1u);
+
+		// Allocations bound with glBindBufferRange have to respect the target's offset alignment
+		GLint offsetAlignment = 1;
+		if (target == GL_UNIFORM_BUFFER)
+		{
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+		}
+		if (target == GL_SHADER_STORAGE_BUFFER)
+		{
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+		}
+		alignment = std::max(offsetAlignment, 1);
+		this->regionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+		glBufferStorage(target, this->regionSize * this->regionCount, nullptr, flags);
+		mapped = (uint8_t*)glMapBufferRange(target, 0, this->regionSize * this->regionCount, flags);
+		glBindBuffer(target, 0);
+
+		fences.assign(this->regionCount, 0);
+		currentRegion = 0;
+		regionOffset = 0;
+	}
+
+	void destroy()
+	{
+		for (auto& fence : fences)
+		{
+			if (fence != 0)
+			{
+				glDeleteSync(fence);
+				fence = 0;
+			}
+		}
+		if (buffer != 0)
+		{
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			glBindBuffer(target, 0);
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+		mapped = nullptr;
+	}
+
+	bool isCreated() const
+	{
+		return (mapped != nullptr);
+	}
+
+	GLuint getBuffer() const
+	{
+		return buffer;
+	}
+
+	// Returns a write only pointer valid for the current frame
+	// If the region is full, the buffer moves on to the next region (which may have to wait for the gpu)
+	Allocation allocate(GLsizeiptr size)
+	{
+		Allocation allocation;
+		GLsizeiptr alignedSize = (size + alignment - 1) / alignment * alignment;
+		if (alignedSize > regionSize)
+		{
+			printf("StreamingBuffer: allocation of %d bytes exceeds region size of %d bytes\n", (int)size, (int)regionSize);
+			return allocation;
+		}
+		if (regionOffset + alignedSize > regionSize)
+		{
+			stats.overflows++;
+			advance();
+		}
+		allocation.offset = currentRegion * regionSize + regionOffset;
+		allocation.pointer = mapped + allocation.offset;
+		allocation.size = size;
+		regionOffset += alignedSize;
+		return allocation;
+	}
+
+	void bindRange(GLuint index, const Allocation &allocation)
+	{
+		glBindBufferRange(target, index, buffer, allocation.offset, allocation.size);
+	}
+
+	// Call once per frame after all commands reading from the current region have been submitted
+	void nextFrame()
+	{
+		stats.frames++;
+		stats.frameBytes = regionOffset;
+		advance();
+	}
+};
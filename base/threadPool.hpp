@@ -0,0 +1,139 @@
+/*
+* Simple thread pool for splitting loops across worker threads
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	bool destroying = false;
+	// Incremented for each parallelFor call, wakes up the workers
+	uint64_t generation = 0;
+	uint32_t busyWorkers = 0;
+
+	// Current job, split into chunks that are grabbed by the workers and the calling thread
+	const std::function<void(uint32_t, uint32_t)> *job = nullptr;
+	uint32_t jobCount = 0;
+	uint32_t jobGrainSize = 0;
+	uint32_t chunkCount = 0;
+	std::atomic<uint32_t> nextChunk;
+
+	void runChunks()
+	{
+		uint32_t chunk;
+		while ((chunk = nextChunk.fetch_add(1)) < chunkCount)
+		{
+			uint32_t begin = chunk * jobGrainSize;
+			uint32_t end = std::min(begin + jobGrainSize, jobCount);
+			(*job)(begin, end);
+		}
+	}
+
+	void workerLoop()
+	{
+		uint64_t lastGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeCondition.wait(lock, [&] { return destroying || (generation != lastGeneration); });
+				if (destroying)
+				{
+					return;
+				}
+				lastGeneration = generation;
+			}
+			runChunks();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--busyWorkers == 0)
+				{
+					doneCondition.notify_one();
+				}
+			}
+		}
+	}
+
+public:
+	// The calling thread also works on the chunks, so one thread less than available is created by default
+	ThreadPool(uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u) - 1)
+	{
+		nextChunk = 0;
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			destroying = true;
+		}
+		wakeCondition.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	uint32_t getThreadCount() const
+	{
+		return static_cast<uint32_t>(workers.size()) + 1;
+	}
+
+	// Calls func(begin, end) for consecutive ranges of at most grainSize elements in [0, count)
+	// Returns after all ranges have been processed
+	void parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)> &func)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		grainSize = std::max(grainSize, 1u);
+		uint32_t chunks = (count + grainSize - 1) / grainSize;
+
+		// Not worth waking up the workers
+		if ((chunks == 1) || (workers.empty()))
+		{
+			func(0, count);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &func;
+			jobCount = count;
+			jobGrainSize = grainSize;
+			chunkCount = chunks;
+			nextChunk = 0;
+			busyWorkers = static_cast<uint32_t>(workers.size());
+			generation++;
+		}
+		wakeCondition.notify_all();
+
+		runChunks();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+	}
+};
@@ -0,0 +1,146 @@
+/*
+* Compute workgroup size auto tuning with GPU timer queries and a per driver result cache
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <algorithm>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <GL/glew.h>
+
+// Times dispatches with GL_TIME_ELAPSED queries to find the fastest workgroup size for a kernel
+// The best size depends on the GPU and driver, so results are stored per kernel and driver (vendor, renderer
+// and version string) in a small text file and reused on the next start
+class WorkgroupSizeTuner
+{
+private:
+	std::string directory;
+	std::string fileName;
+	// "kernel|driver" -> workgroup size
+	std::map<std::string, uint32_t> results;
+	bool loaded = false;
+
+	static std::string getDriverId()
+	{
+		return std::string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+	}
+
+	void readResults()
+	{
+		if (loaded)
+		{
+			return;
+		}
+		loaded = true;
+		std::ifstream file(directory + "/" + fileName);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			// Last field is the size, the key may contain anything but line breaks
+			size_t separator = line.find_last_of('=');
+			if (separator != std::string::npos)
+			{
+				results[line.substr(0, separator)] = (uint32_t)strtoul(line.c_str() + separator + 1, nullptr, 10);
+			}
+		}
+	}
+
+	void writeResults()
+	{
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+		std::ofstream file(directory + "/" + fileName);
+		if (!file.is_open())
+		{
+			printf("Workgroup tuner: could not write %s/%s\n", directory.c_str(), fileName.c_str());
+			return;
+		}
+		for (auto& result : results)
+		{
+			file << result.first << "=" << result.second << "\n";
+		}
+	}
+
+public:
+	WorkgroupSizeTuner(const std::string &directory = "shadercache", const std::string &fileName = "workgroupsizes.txt")
+	{
+		this->directory = directory;
+		this->fileName = fileName;
+	}
+
+	// Returns false if the kernel hasn't been tuned for the current driver yet
+	bool load(const std::string &kernel, uint32_t &workgroupSize)
+	{
+		readResults();
+		auto it = results.find(kernel + "|" + getDriverId());
+		if (it == results.end())
+		{
+			return false;
+		}
+		workgroupSize = it->second;
+		return true;
+	}
+
+	void store(const std::string &kernel, uint32_t workgroupSize)
+	{
+		readResults();
+		results[kernel + "|" + getDriverId()] = workgroupSize;
+		writeResults();
+	}
+
+	// Powers of two from minSize up to the implementation's limit for 1D workgroups
+	static std::vector<uint32_t> getCandidates(uint32_t minSize = 32)
+	{
+		GLint maxInvocations = 0;
+		GLint maxSizeX = 0;
+		glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+		glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxSizeX);
+		uint32_t maxSize = (uint32_t)std::min(maxInvocations, maxSizeX);
+		std::vector<uint32_t> candidates;
+		for (uint32_t size = minSize; size <= maxSize; size *= 2)
+		{
+			candidates.push_back(size);
+		}
+		return candidates;
+	}
+
+	// Runs the dispatch function once to warm up, then times the given number of iterations on the GPU
+	// Returns the average GPU time per iteration in milliseconds
+	static double measure(const std::function<void()> &dispatch, uint32_t iterations = 16)
+	{
+		dispatch();
+		GLuint query;
+		glGenQueries(1, &query);
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			dispatch();
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		// Blocks until the GPU is done, tuning is a one time operation
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+		glDeleteQueries(1, &query);
+		return (double)elapsed / 1000000.0 / (double)iterations;
+	}
+};
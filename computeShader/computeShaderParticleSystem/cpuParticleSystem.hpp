@@ -0,0 +1,580 @@
+/*
+This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+ 2014 by Sascha Willems - http://www.saschawillems.de
+
+CPU implementation of the particle simulation in data/shader/particlesystem.shader
+Particles are stored as structure of arrays, updated with SSE4.1, AVX2 or AVX-512 (selected at runtime)
+and split across a thread pool
+Used as a fallback for drivers without compute shaders and to verify the results of the GPU simulation
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "../../base/threadPool.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PARTICLE_SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+// AVX-512 intrinsics require Visual Studio 2017 (15.3) or later
+#if !defined(_MSC_VER) || (_MSC_VER >= 1911)
+#define PARTICLE_SIMD_AVX512
+#endif
+#endif
+
+// Functions using instruction sets above the compiler's baseline have to be marked for gcc and clang
+// Visual Studio allows all intrinsics in any function
+// Multiplies and adds must not be contracted into fused multiply-adds (which gcc does for vector
+// intrinsics as soon as the target has FMA), otherwise the paths would no longer give identical results
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#define PARTICLE_NO_FMA
+#define PARTICLE_SIMD_TARGET(isa) __attribute__((target(isa)))
+#elif defined(__GNUC__)
+#define PARTICLE_NO_FMA __attribute__((optimize("fp-contract=off")))
+#define PARTICLE_SIMD_TARGET(isa) __attribute__((target(isa), optimize("fp-contract=off")))
+#else
+#define PARTICLE_NO_FMA
+#define PARTICLE_SIMD_TARGET(isa)
+#endif
+
+#define CPU_SIMD_SCALAR 0
+#define CPU_SIMD_SSE41 1
+#define CPU_SIMD_AVX2 2
+#define CPU_SIMD_AVX512 3
+#define CPU_SIMD_COUNT 4
+
+// Particles per thread pool job
+#define CPU_PARTICLE_GRAIN_SIZE 16384
+
+class CpuParticleSystem
+{
+public:
+	// Same as the uniforms of the compute shader
+	struct Params
+	{
+		float deltaT = 0.0f;
+		float destPosX = 0.0f;
+		float destPosY = 0.0f;
+		float vpDimX = 1.0f;
+		float vpDimY = 1.0f;
+		bool borderClamp = true;
+		bool applyGravity = false;
+	};
+
+	// Largest differences between two particle systems
+	struct Comparison
+	{
+		float maxPositionError = 0.0f;
+		float maxVelocityError = 0.0f;
+		// Number of particles outside of the tolerance, and the first one of them
+		uint32_t mismatches = 0;
+		uint32_t firstMismatch = 0;
+	};
+
+	std::vector<float> positionsX;
+	std::vector<float> positionsY;
+	std::vector<float> velocitiesX;
+	std::vector<float> velocitiesY;
+	// Instruction set used by update(), defaults to the best one supported by the cpu
+	uint32_t simdLevel = getSupportedSimdLevel();
+
+	uint32_t size() const
+	{
+		return (uint32_t)positionsX.size();
+	}
+
+	// New particles are placed at the origin without velocity
+	void resize(uint32_t count)
+	{
+		positionsX.resize(count, 0.0f);
+		positionsY.resize(count, 0.0f);
+		velocitiesX.resize(count, 0.0f);
+		velocitiesY.resize(count, 0.0f);
+	}
+
+	// Places a range of particles around the center with the same hash as data/shader/particlereset.shader
+	void seed(uint32_t first, uint32_t count, float centerX, float centerY, float radius, uint32_t seed)
+	{
+		for (uint32_t index = first; index < first + count; index++)
+		{
+			uint32_t hash = pcgHash(index ^ pcgHash(seed));
+			float angle = toUnitFloat(hash) * 6.28318531f;
+			float distance = toUnitFloat(pcgHash(hash)) * radius;
+			positionsX[index] = centerX + cosf(angle) * distance;
+			positionsY[index] = centerY + sinf(angle) * distance;
+			velocitiesX[index] = 0.0f;
+			velocitiesY[index] = 0.0f;
+		}
+	}
+
+	// Advances all particles by one step
+	// If vertices is not null, the new positions are also written to it as interleaved xy pairs (e.g. into a mapped vertex buffer)
+	void update(ThreadPool &threadPool, const Params &params, float *vertices)
+	{
+		uint32_t level = simdLevel;
+		threadPool.parallelFor(size(), CPU_PARTICLE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+		{
+			updateRange(level, params, begin, end, vertices);
+		});
+	}
+
+	// Updates the particles in [begin, end) on the calling thread
+	void updateRange(uint32_t level, const Params &params, uint32_t begin, uint32_t end, float *vertices)
+	{
+		switch (level)
+		{
+#ifdef PARTICLE_SIMD_X86
+#ifdef PARTICLE_SIMD_AVX512
+		case CPU_SIMD_AVX512:
+			begin = updateAVX512(params, begin, end, vertices);
+			break;
+#endif
+		case CPU_SIMD_AVX2:
+			begin = updateAVX2(params, begin, end, vertices);
+			break;
+		case CPU_SIMD_SSE41:
+			begin = updateSSE41(params, begin, end, vertices);
+			break;
+#endif
+		default:
+			break;
+		}
+		// Remaining particles that don't fill a whole vector
+		updateScalar(params, begin, end, vertices);
+	}
+
+	// A particle mismatches if the difference is larger than tolerance * max(1, |value|) for any component
+	Comparison compare(const CpuParticleSystem &other, float positionTolerance, float velocityTolerance) const
+	{
+		Comparison result;
+		uint32_t count = std::min(size(), other.size());
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float positionError = std::max(fabsf(positionsX[i] - other.positionsX[i]), fabsf(positionsY[i] - other.positionsY[i]));
+			float velocityError = std::max(fabsf(velocitiesX[i] - other.velocitiesX[i]), fabsf(velocitiesY[i] - other.velocitiesY[i]));
+			result.maxPositionError = std::max(result.maxPositionError, positionError);
+			result.maxVelocityError = std::max(result.maxVelocityError, velocityError);
+			float positionScale = std::max(1.0f, std::max(fabsf(positionsX[i]), fabsf(positionsY[i])));
+			float velocityScale = std::max(1.0f, std::max(fabsf(velocitiesX[i]), fabsf(velocitiesY[i])));
+			// Negated, so NaNs count as mismatches
+			if (!(positionError <= positionTolerance * positionScale) || !(velocityError <= velocityTolerance * velocityScale))
+			{
+				if (result.mismatches == 0)
+				{
+					result.firstMismatch = i;
+				}
+				result.mismatches++;
+			}
+		}
+		return result;
+	}
+
+	static const char* getSimdLevelName(uint32_t level)
+	{
+		const char* names[CPU_SIMD_COUNT] = { "scalar", "SSE4.1", "AVX2", "AVX-512" };
+		return (level < CPU_SIMD_COUNT) ? names[level] : "unknown";
+	}
+
+	// Highest instruction set supported by both the cpu and the operating system (saving the wider registers)
+	static uint32_t getSupportedSimdLevel()
+	{
+#ifdef PARTICLE_SIMD_X86
+		uint32_t leaf1[4], leaf7[4];
+		cpuid(1, 0, leaf1);
+		cpuid(7, 0, leaf7);
+		uint64_t xcr0 = ((leaf1[2] & (1u << 27)) != 0) ? readXCR0() : 0;
+		bool sse41 = (leaf1[2] & (1u << 19)) != 0;
+		bool avx = ((leaf1[2] & (1u << 28)) != 0) && ((xcr0 & 0x6) == 0x6);
+		bool avx2 = avx && ((leaf7[1] & (1u << 5)) != 0);
+		bool avx512 = avx2 && ((leaf7[1] & (1u << 16)) != 0) && ((xcr0 & 0xE6) == 0xE6);
+#ifdef PARTICLE_SIMD_AVX512
+		if (avx512)
+		{
+			return CPU_SIMD_AVX512;
+		}
+#endif
+		if (avx2)
+		{
+			return CPU_SIMD_AVX2;
+		}
+		if (sse41)
+		{
+			return CPU_SIMD_SSE41;
+		}
+#endif
+		return CPU_SIMD_SCALAR;
+	}
+
+	// Headless regression test, no GL context required
+	// Runs all supported instruction sets multi threaded against the single threaded scalar reference
+	// The vector paths use the same operations in the same order, so results have to match exactly
+	static bool selfTest(ThreadPool &threadPool, uint32_t particleCount = 1000003, uint32_t steps = 100)
+	{
+		printf("CPU particle simulation self test: %u particles, %u steps, %u threads\n", particleCount, steps, threadPool.getThreadCount());
+		Params params;
+		params.deltaT = 0.25f;
+		params.destPosX = 0.3f;
+		params.destPosY = -0.2f;
+		params.applyGravity = true;
+
+		CpuParticleSystem reference;
+		reference.resize(particleCount);
+		reference.seed(0, particleCount, 0.0f, 0.0f, 1.2f, 1);
+		for (uint32_t step = 0; step < steps; step++)
+		{
+			params.borderClamp = (step % 2 == 0);
+			reference.updateRange(CPU_SIMD_SCALAR, params, 0, particleCount, nullptr);
+		}
+
+		bool passed = true;
+		std::vector<float> vertices(particleCount * 2);
+		for (uint32_t level = CPU_SIMD_SCALAR; level <= getSupportedSimdLevel(); level++)
+		{
+			CpuParticleSystem particles;
+			particles.simdLevel = level;
+			particles.resize(particleCount);
+			particles.seed(0, particleCount, 0.0f, 0.0f, 1.2f, 1);
+			std::fill(vertices.begin(), vertices.end(), 0.0f);
+			double time = 0.0;
+			for (uint32_t step = 0; step < steps; step++)
+			{
+				params.borderClamp = (step % 2 == 0);
+				double start = getTime();
+				particles.update(threadPool, params, vertices.data());
+				time += getTime() - start;
+			}
+			Comparison comparison = particles.compare(reference, 0.0f, 0.0f);
+			// The vertex output has to match the positions
+			uint32_t vertexMismatches = 0;
+			for (uint32_t i = 0; i < particleCount; i++)
+			{
+				if ((vertices[i * 2] != particles.positionsX[i]) || (vertices[i * 2 + 1] != particles.positionsY[i]))
+				{
+					vertexMismatches++;
+				}
+			}
+			bool levelPassed = (comparison.mismatches == 0) && (vertexMismatches == 0);
+			passed &= levelPassed;
+			printf("%-8s: %s, %.3f ms per step (%.1f M particles/s), max. error position %g velocity %g", getSimdLevelName(level), levelPassed ? "passed" : "FAILED", time / steps * 1000.0, (double)particleCount * steps / time / 1000000.0, comparison.maxPositionError, comparison.maxVelocityError);
+			if (!levelPassed)
+			{
+				printf(", %u mismatches (first at %u), %u vertex mismatches", comparison.mismatches, comparison.firstMismatch, vertexMismatches);
+			}
+			printf("\n");
+		}
+		return passed;
+	}
+
+private:
+	static uint32_t pcgHash(uint32_t value)
+	{
+		uint32_t state = value * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	static float toUnitFloat(uint32_t value)
+	{
+		return (float)(value >> 8u) * (1.0f / 16777216.0f);
+	}
+
+	static double getTime()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Reference implementation, mirrors the shader line by line
+	PARTICLE_NO_FMA
+	void updateScalar(const Params &params, uint32_t begin, uint32_t end, float *vertices)
+	{
+		const float attraction = 0.001f;
+		const float gravityY = -9.8f * 0.00001f;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			float posX = positionsX[i];
+			float posY = positionsY[i];
+			float velX = velocitiesX[i];
+			float velY = velocitiesY[i];
+
+			float dirX = params.destPosX - posX;
+			float dirY = params.destPosY - posY;
+			float invLength = 1.0f / sqrtf(dirX * dirX + dirY * dirY);
+			velX += dirX * invLength * attraction * params.deltaT;
+			velY += dirY * invLength * attraction * params.deltaT;
+
+			if (params.applyGravity)
+			{
+				velY += gravityY * params.deltaT;
+			}
+
+			posX += velX * params.deltaT;
+			posY += velY * params.deltaT;
+
+			if (params.borderClamp)
+			{
+				if (posX < -params.vpDimX)
+				{
+					posX = -params.vpDimX;
+					velX = -velX;
+				}
+				if (posX > params.vpDimX)
+				{
+					posX = params.vpDimX;
+					velX = -velX;
+				}
+				if (posY < -params.vpDimY)
+				{
+					posY = -params.vpDimY;
+					velY = -velY;
+				}
+				if (posY > params.vpDimY)
+				{
+					posY = params.vpDimY;
+					velY = -velY;
+				}
+			}
+
+			positionsX[i] = posX;
+			positionsY[i] = posY;
+			velocitiesX[i] = velX;
+			velocitiesY[i] = velY;
+			if (vertices)
+			{
+				vertices[i * 2] = posX;
+				vertices[i * 2 + 1] = posY;
+			}
+		}
+	}
+
+#ifdef PARTICLE_SIMD_X86
+	static void cpuid(uint32_t leaf, uint32_t subLeaf, uint32_t registers[4])
+	{
+#ifdef _MSC_VER
+		__cpuidex((int*)registers, (int)leaf, (int)subLeaf);
+#else
+		if (!__get_cpuid_count(leaf, subLeaf, &registers[0], &registers[1], &registers[2], &registers[3]))
+		{
+			registers[0] = registers[1] = registers[2] = registers[3] = 0;
+		}
+#endif
+	}
+
+	// Register state enabled by the operating system, only valid if the cpu reports OSXSAVE
+	static uint64_t readXCR0()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		uint32_t eax, edx;
+		__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t)edx << 32) | eax;
+#endif
+	}
+
+	// The vector paths return the index of the first particle they didn't process
+	// Same operations in the same order as the scalar path, so the results are identical
+
+	PARTICLE_SIMD_TARGET("sse4.1")
+	uint32_t updateSSE41(const Params &params, uint32_t begin, uint32_t end, float *vertices)
+	{
+		const __m128 deltaT = _mm_set1_ps(params.deltaT);
+		const __m128 destPosX = _mm_set1_ps(params.destPosX);
+		const __m128 destPosY = _mm_set1_ps(params.destPosY);
+		const __m128 maxX = _mm_set1_ps(params.vpDimX);
+		const __m128 maxY = _mm_set1_ps(params.vpDimY);
+		const __m128 minX = _mm_set1_ps(-params.vpDimX);
+		const __m128 minY = _mm_set1_ps(-params.vpDimY);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 attraction = _mm_set1_ps(0.001f);
+		const __m128 gravityY = _mm_set1_ps(-9.8f * 0.00001f);
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		uint32_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 posX = _mm_loadu_ps(&positionsX[i]);
+			__m128 posY = _mm_loadu_ps(&positionsY[i]);
+			__m128 velX = _mm_loadu_ps(&velocitiesX[i]);
+			__m128 velY = _mm_loadu_ps(&velocitiesY[i]);
+
+			__m128 dirX = _mm_sub_ps(destPosX, posX);
+			__m128 dirY = _mm_sub_ps(destPosY, posY);
+			__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dirX, dirX), _mm_mul_ps(dirY, dirY))));
+			velX = _mm_add_ps(velX, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(dirX, invLength), attraction), deltaT));
+			velY = _mm_add_ps(velY, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(dirY, invLength), attraction), deltaT));
+			if (params.applyGravity)
+			{
+				velY = _mm_add_ps(velY, _mm_mul_ps(gravityY, deltaT));
+			}
+
+			posX = _mm_add_ps(posX, _mm_mul_ps(velX, deltaT));
+			posY = _mm_add_ps(posY, _mm_mul_ps(velY, deltaT));
+
+			if (params.borderClamp)
+			{
+				__m128 belowX = _mm_cmplt_ps(posX, minX);
+				__m128 aboveX = _mm_cmpgt_ps(posX, maxX);
+				__m128 belowY = _mm_cmplt_ps(posY, minY);
+				__m128 aboveY = _mm_cmpgt_ps(posY, maxY);
+				posX = _mm_blendv_ps(_mm_blendv_ps(posX, minX, belowX), maxX, aboveX);
+				posY = _mm_blendv_ps(_mm_blendv_ps(posY, minY, belowY), maxY, aboveY);
+				velX = _mm_blendv_ps(velX, _mm_xor_ps(velX, signBit), _mm_or_ps(belowX, aboveX));
+				velY = _mm_blendv_ps(velY, _mm_xor_ps(velY, signBit), _mm_or_ps(belowY, aboveY));
+			}
+
+			_mm_storeu_ps(&positionsX[i], posX);
+			_mm_storeu_ps(&positionsY[i], posY);
+			_mm_storeu_ps(&velocitiesX[i], velX);
+			_mm_storeu_ps(&velocitiesY[i], velY);
+			if (vertices)
+			{
+				_mm_storeu_ps(&vertices[i * 2], _mm_unpacklo_ps(posX, posY));
+				_mm_storeu_ps(&vertices[i * 2 + 4], _mm_unpackhi_ps(posX, posY));
+			}
+		}
+		return i;
+	}
+
+	PARTICLE_SIMD_TARGET("avx2")
+	uint32_t updateAVX2(const Params &params, uint32_t begin, uint32_t end, float *vertices)
+	{
+		const __m256 deltaT = _mm256_set1_ps(params.deltaT);
+		const __m256 destPosX = _mm256_set1_ps(params.destPosX);
+		const __m256 destPosY = _mm256_set1_ps(params.destPosY);
+		const __m256 maxX = _mm256_set1_ps(params.vpDimX);
+		const __m256 maxY = _mm256_set1_ps(params.vpDimY);
+		const __m256 minX = _mm256_set1_ps(-params.vpDimX);
+		const __m256 minY = _mm256_set1_ps(-params.vpDimY);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 attraction = _mm256_set1_ps(0.001f);
+		const __m256 gravityY = _mm256_set1_ps(-9.8f * 0.00001f);
+		const __m256 signBit = _mm256_set1_ps(-0.0f);
+		uint32_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 posX = _mm256_loadu_ps(&positionsX[i]);
+			__m256 posY = _mm256_loadu_ps(&positionsY[i]);
+			__m256 velX = _mm256_loadu_ps(&velocitiesX[i]);
+			__m256 velY = _mm256_loadu_ps(&velocitiesY[i]);
+
+			__m256 dirX = _mm256_sub_ps(destPosX, posX);
+			__m256 dirY = _mm256_sub_ps(destPosY, posY);
+			__m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dirX, dirX), _mm256_mul_ps(dirY, dirY))));
+			velX = _mm256_add_ps(velX, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(dirX, invLength), attraction), deltaT));
+			velY = _mm256_add_ps(velY, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(dirY, invLength), attraction), deltaT));
+			if (params.applyGravity)
+			{
+				velY = _mm256_add_ps(velY, _mm256_mul_ps(gravityY, deltaT));
+			}
+
+			posX = _mm256_add_ps(posX, _mm256_mul_ps(velX, deltaT));
+			posY = _mm256_add_ps(posY, _mm256_mul_ps(velY, deltaT));
+
+			if (params.borderClamp)
+			{
+				__m256 belowX = _mm256_cmp_ps(posX, minX, _CMP_LT_OQ);
+				__m256 aboveX = _mm256_cmp_ps(posX, maxX, _CMP_GT_OQ);
+				__m256 belowY = _mm256_cmp_ps(posY, minY, _CMP_LT_OQ);
+				__m256 aboveY = _mm256_cmp_ps(posY, maxY, _CMP_GT_OQ);
+				posX = _mm256_blendv_ps(_mm256_blendv_ps(posX, minX, belowX), maxX, aboveX);
+				posY = _mm256_blendv_ps(_mm256_blendv_ps(posY, minY, belowY), maxY, aboveY);
+				velX = _mm256_xor_ps(velX, _mm256_and_ps(signBit, _mm256_or_ps(belowX, aboveX)));
+				velY = _mm256_xor_ps(velY, _mm256_and_ps(signBit, _mm256_or_ps(belowY, aboveY)));
+			}
+
+			_mm256_storeu_ps(&positionsX[i], posX);
+			_mm256_storeu_ps(&positionsY[i], posY);
+			_mm256_storeu_ps(&velocitiesX[i], velX);
+			_mm256_storeu_ps(&velocitiesY[i], velY);
+			if (vertices)
+			{
+				// Unpacking works per 128 bit lane, so the halves have to be swapped into order
+				__m256 low = _mm256_unpacklo_ps(posX, posY);
+				__m256 high = _mm256_unpackhi_ps(posX, posY);
+				_mm256_storeu_ps(&vertices[i * 2], _mm256_permute2f128_ps(low, high, 0x20));
+				_mm256_storeu_ps(&vertices[i * 2 + 8], _mm256_permute2f128_ps(low, high, 0x31));
+			}
+		}
+		return i;
+	}
+
+#ifdef PARTICLE_SIMD_AVX512
+	PARTICLE_SIMD_TARGET("avx512f")
+	uint32_t updateAVX512(const Params &params, uint32_t begin, uint32_t end, float *vertices)
+	{
+		const __m512 deltaT = _mm512_set1_ps(params.deltaT);
+		const __m512 destPosX = _mm512_set1_ps(params.destPosX);
+		const __m512 destPosY = _mm512_set1_ps(params.destPosY);
+		const __m512 maxX = _mm512_set1_ps(params.vpDimX);
+		const __m512 maxY = _mm512_set1_ps(params.vpDimY);
+		const __m512 minX = _mm512_set1_ps(-params.vpDimX);
+		const __m512 minY = _mm512_set1_ps(-params.vpDimY);
+		const __m512 one = _mm512_set1_ps(1.0f);
+		const __m512 attraction = _mm512_set1_ps(0.001f);
+		const __m512 gravityY = _mm512_set1_ps(-9.8f * 0.00001f);
+		const __m512i signBit = _mm512_set1_epi32((int)0x80000000);
+		// Interleaves x (indices 0-15) and y (indices 16-31) into xy pairs
+		const __m512i interleaveLow = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+		const __m512i interleaveHigh = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+		uint32_t i = begin;
+		for (; i + 16 <= end; i += 16)
+		{
+			__m512 posX = _mm512_loadu_ps(&positionsX[i]);
+			__m512 posY = _mm512_loadu_ps(&positionsY[i]);
+			__m512 velX = _mm512_loadu_ps(&velocitiesX[i]);
+			__m512 velY = _mm512_loadu_ps(&velocitiesY[i]);
+
+			__m512 dirX = _mm512_sub_ps(destPosX, posX);
+			__m512 dirY = _mm512_sub_ps(destPosY, posY);
+			__m512 invLength = _mm512_div_ps(one, _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(dirX, dirX), _mm512_mul_ps(dirY, dirY))));
+			velX = _mm512_add_ps(velX, _mm512_mul_ps(_mm512_mul_ps(_mm512_mul_ps(dirX, invLength), attraction), deltaT));
+			velY = _mm512_add_ps(velY, _mm512_mul_ps(_mm512_mul_ps(_mm512_mul_ps(dirY, invLength), attraction), deltaT));
+			if (params.applyGravity)
+			{
+				velY = _mm512_add_ps(velY, _mm512_mul_ps(gravityY, deltaT));
+			}
+
+			posX = _mm512_add_ps(posX, _mm512_mul_ps(velX, deltaT));
+			posY = _mm512_add_ps(posY, _mm512_mul_ps(velY, deltaT));
+
+			if (params.borderClamp)
+			{
+				__mmask16 belowX = _mm512_cmp_ps_mask(posX, minX, _CMP_LT_OQ);
+				__mmask16 aboveX = _mm512_cmp_ps_mask(posX, maxX, _CMP_GT_OQ);
+				__mmask16 belowY = _mm512_cmp_ps_mask(posY, minY, _CMP_LT_OQ);
+				__mmask16 aboveY = _mm512_cmp_ps_mask(posY, maxY, _CMP_GT_OQ);
+				posX = _mm512_mask_blend_ps(aboveX, _mm512_mask_blend_ps(belowX, posX, minX), maxX);
+				posY = _mm512_mask_blend_ps(aboveY, _mm512_mask_blend_ps(belowY, posY, minY), maxY);
+				// Floating point xor needs AVX512DQ, flip the sign bit as integers instead
+				__m512i bitsX = _mm512_castps_si512(velX);
+				__m512i bitsY = _mm512_castps_si512(velY);
+				velX = _mm512_castsi512_ps(_mm512_mask_xor_epi32(bitsX, belowX | aboveX, bitsX, signBit));
+				velY = _mm512_castsi512_ps(_mm512_mask_xor_epi32(bitsY, belowY | aboveY, bitsY, signBit));
+			}
+
+			_mm512_storeu_ps(&positionsX[i], posX);
+			_mm512_storeu_ps(&positionsY[i], posY);
+			_mm512_storeu_ps(&velocitiesX[i], velX);
+			_mm512_storeu_ps(&velocitiesY[i], velY);
+			if (vertices)
+			{
+				_mm512_storeu_ps(&vertices[i * 2], _mm512_permutex2var_ps(posX, interleaveLow, posY));
+				_mm512_storeu_ps(&vertices[i * 2 + 16], _mm512_permutex2var_ps(posX, interleaveHigh, posY));
+			}
+		}
+		return i;
+	}
+#endif
+#endif
+};
@@ -0,0 +1,21 @@
+// Invocation indices of particle dispatches
+// Dispatches that need more workgroups than GL_MAX_COMPUTE_WORK_GROUP_COUNT allows in x (the guaranteed
+// minimum is 65535) are split over the x and y dimension of the grid, see glRenderer::dispatchParticles
+// Rows have the same number of workgroups, so the grid may extend past the end and shaders have to
+// check the index against their element count
+
+// Linear index of the workgroup, replaces gl_WorkGroupID.x
+uint getLinearWorkGroupIndex() {
+    return gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+}
+
+// Linear index of the invocation, replaces gl_GlobalInvocationID.x
+uint getLinearInvocationIndex() {
+    return getLinearWorkGroupIndex() * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+}
+
+// Workgroup counts in x and y for the given number of workgroups, for dispatch arguments written on the GPU
+uvec2 splitWorkGroups(uint groupCount, uint maxGroupsX) {
+    uint groupsY = max((groupCount + maxGroupsX - 1u) / maxGroupsX, 1u);
+    return uvec2((groupCount + groupsY - 1u) / groupsY, groupsY);
+}
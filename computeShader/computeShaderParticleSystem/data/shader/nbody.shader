@@ -0,0 +1,74 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    N-body gravitation, updates the velocities of all particles
+    Each workgroup loads the sources in tiles of WORKGROUP_SIZE into shared memory, so every position is
+    read from the buffer once per workgroup instead of once per particle
+    Sources are either all particles (exact, O(n^2)) or the cells of a coarse grid (NBODY_GRID, O(n * cells))
+    Positions are only read, they are moved by nbody_integrate.shader once all forces have been applied
+*/
+
+#version 430
+
+#include "particle_buffers.glsl"
+#include "dispatch_index.glsl"
+
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+#ifndef NBODY_GRID
+#define NBODY_GRID 0
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+layout (location = 0) uniform float deltaT;
+layout (location = 1) uniform uint particleCount;
+// Gravitational constant times the mass of a single particle
+layout (location = 2) uniform float particleMass;
+// Avoids infinite forces for close particles (and a particle with itself)
+layout (location = 3) uniform float softeningSqr;
+
+// Position (xy) and mass in particles (z) of a source
+#if NBODY_GRID
+#include "nbody_grid.glsl"
+#define sourceCount GRID_CELL_COUNT
+vec4 loadSource(uint index) { return loadCell(index); }
+#else
+#define sourceCount particleCount
+vec4 loadSource(uint index) { return vec4(loadPosition(index), 1.0, 0.0); }
+#endif
+
+shared vec4 tile[WORKGROUP_SIZE];
+
+void main() {
+
+    uint index = getLinearInvocationIndex();
+    // Invocations past the last particle still load their part of the tiles, so they can't return early
+    bool active = index < particleCount;
+    vec2 position = active ? loadPosition(index) : vec2(0.0);
+    vec2 acceleration = vec2(0.0);
+
+    for (uint tileStart = 0u; tileStart < sourceCount; tileStart += WORKGROUP_SIZE) {
+
+        // Sources past the end have no mass
+        uint source = tileStart + gl_LocalInvocationID.x;
+        tile[gl_LocalInvocationID.x] = (source < sourceCount) ? loadSource(source) : vec4(0.0);
+        memoryBarrierShared();
+        barrier();
+
+        for (uint i = 0u; i < WORKGROUP_SIZE; i++) {
+            vec2 direction = tile[i].xy - position;
+            float invDistance = inversesqrt(dot(direction, direction) + softeningSqr);
+            acceleration += direction * (tile[i].z * invDistance * invDistance * invDistance);
+        }
+
+        // Wait until all invocations are done with the tile before it's overwritten
+        barrier();
+    }
+
+    if (active) {
+        storeVelocity(index, loadVelocity(index) + acceleration * particleMass * deltaT);
+    }
+
+}
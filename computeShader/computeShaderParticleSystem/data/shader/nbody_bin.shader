@@ -0,0 +1,30 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    Adds all particles to the grid of the approximated N-body mode (the grid is cleared by the application)
+*/
+
+#version 430
+
+#include "particle_buffers.glsl"
+#include "dispatch_index.glsl"
+#include "nbody_grid.glsl"
+
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+layout (location = 1) uniform uint particleCount;
+
+void main() {
+
+    uint index = getLinearInvocationIndex();
+    if (index >= particleCount) {
+        return;
+    }
+
+    addToGrid(loadPosition(index));
+
+}
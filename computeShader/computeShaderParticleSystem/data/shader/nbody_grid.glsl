@@ -0,0 +1,55 @@
+// Coarse grid for the approximated N-body mode
+// Each cell sums up the number of particles and their offsets from the cell center, far away particles
+// then only see the cell's center of mass instead of every single particle
+
+#ifndef GRID_SIZE
+#define GRID_SIZE 64
+#endif
+#define GRID_CELL_COUNT uint(GRID_SIZE * GRID_SIZE)
+// The grid covers [-GRID_EXTENT, GRID_EXTENT], particles outside of it are put into the border cells
+#define GRID_EXTENT 1.0
+// Offsets are summed as fixed point integers (core GLSL has no float atomics) in 1/256 of a cell
+#define GRID_FIXED_POINT_SCALE 256.0
+
+struct GridCell {
+    int count;
+    int offsetX;
+    int offsetY;
+    int padding;
+};
+
+layout(std430, binding = 2) buffer Grid {
+    GridCell cells[ ];
+};
+
+const float cellSize = 2.0 * GRID_EXTENT / float(GRID_SIZE);
+
+ivec2 getCell(vec2 position) {
+    return clamp(ivec2(floor((position + GRID_EXTENT) / cellSize)), ivec2(0), ivec2(GRID_SIZE - 1));
+}
+
+vec2 getCellCenter(ivec2 cell) {
+    return (vec2(cell) + 0.5) * cellSize - GRID_EXTENT;
+}
+
+void addToGrid(vec2 position) {
+    ivec2 cell = getCell(position);
+    uint index = uint(cell.y * GRID_SIZE + cell.x);
+    // Offsets of particles far outside of the grid are limited, so the sums can't overflow
+    vec2 offset = clamp((position - getCellCenter(cell)) / cellSize, -64.0, 64.0);
+    ivec2 fixedOffset = ivec2(round(offset * GRID_FIXED_POINT_SCALE));
+    atomicAdd(cells[index].count, 1);
+    atomicAdd(cells[index].offsetX, fixedOffset.x);
+    atomicAdd(cells[index].offsetY, fixedOffset.y);
+}
+
+// Center of mass (xy) and number of particles (z) of a cell
+vec4 loadCell(uint index) {
+    GridCell gridCell = cells[index];
+    if (gridCell.count == 0) {
+        return vec4(0.0);
+    }
+    ivec2 cell = ivec2(index % uint(GRID_SIZE), index / uint(GRID_SIZE));
+    vec2 offset = vec2(gridCell.offsetX, gridCell.offsetY) / (GRID_FIXED_POINT_SCALE * float(gridCell.count));
+    return vec4(getCellCenter(cell) + offset * cellSize, float(gridCell.count), 0.0);
+}
@@ -0,0 +1,65 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    Moves the particles of the N-body modes by their velocities
+    Runs after the forces of all particles have been applied, as positions are shared between all invocations
+*/
+
+#version 430
+
+#include "particle_buffers.glsl"
+#include "dispatch_index.glsl"
+
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+layout (location = 0) uniform float deltaT;
+layout (location = 1) uniform uint particleCount;
+
+// Viewport dimensions for border clamp
+layout (location = 2) uniform vec2 vpDim;
+layout (location = 3) uniform int borderClamp;
+
+void main() {
+
+    uint index = getLinearInvocationIndex();
+    if (index >= particleCount) {
+        return;
+    }
+
+    vec2 vPos = loadPosition(index);
+    vec2 vVel = loadVelocity(index);
+
+    vPos += vVel * deltaT;
+
+    if (borderClamp == 1) {
+
+        if (vPos.x < -vpDim.x) {
+            vPos.x = -vpDim.x;
+            vVel.x = -vVel.x;
+        }
+
+        if (vPos.x > vpDim.x) {
+            vPos.x = vpDim.x;
+            vVel.x = -vVel.x;
+        }
+
+        if (vPos.y < -vpDim.y) {
+            vPos.y = -vpDim.y;
+            vVel.y = -vVel.y;
+        }
+
+        if (vPos.y > vpDim.y) {
+            vPos.y = vpDim.y;
+            vVel.y = -vVel.y;
+        }
+
+    }
+
+    storePosition(index, vPos);
+    storeVelocity(index, vVel);
+
+}
@@ -0,0 +1,81 @@
+// Particle storage, shared by all particle compute shaders
+// PARTICLE_LAYOUT selects how positions and velocities are stored (must match the PARTICLE_LAYOUT_* defines on the host)
+// Particles move in the xy plane, so only two components are stored by the packed layouts
+// Shaders access particles through the load/store functions only
+
+#ifndef PARTICLE_LAYOUT
+#define PARTICLE_LAYOUT 0
+#endif
+
+#if PARTICLE_LAYOUT == 0
+
+// std140 vec4 arrays (32 bytes per particle)
+
+// Target 0 : Vertex position
+layout(std140, binding = 0) buffer Pos {
+   vec4 Positions[ ];
+};
+
+// Target 1 : Vertex velocity
+layout(std140, binding = 1) buffer Vel {
+    vec4 Velocities[ ];
+};
+
+vec2 loadPosition(uint index) { return Positions[index].xy; }
+vec2 loadVelocity(uint index) { return Velocities[index].xy; }
+void storePosition(uint index, vec2 position) { Positions[index] = vec4(position, 0.0, 1.0); }
+void storeVelocity(uint index, vec2 velocity) { Velocities[index] = vec4(velocity, 0.0, 1.0); }
+
+#elif PARTICLE_LAYOUT == 1
+
+// std430 packed vec2 arrays (16 bytes per particle)
+
+layout(std430, binding = 0) buffer Pos {
+   vec2 Positions[ ];
+};
+
+layout(std430, binding = 1) buffer Vel {
+    vec2 Velocities[ ];
+};
+
+vec2 loadPosition(uint index) { return Positions[index]; }
+vec2 loadVelocity(uint index) { return Velocities[index]; }
+void storePosition(uint index, vec2 position) { Positions[index] = position; }
+void storeVelocity(uint index, vec2 velocity) { Velocities[index] = velocity; }
+
+#elif PARTICLE_LAYOUT == 2
+
+// std430 vec2 positions, half precision velocities (12 bytes per particle)
+
+layout(std430, binding = 0) buffer Pos {
+   vec2 Positions[ ];
+};
+
+layout(std430, binding = 1) buffer Vel {
+    uint Velocities[ ];
+};
+
+vec2 loadPosition(uint index) { return Positions[index]; }
+vec2 loadVelocity(uint index) { return unpackHalf2x16(Velocities[index]); }
+void storePosition(uint index, vec2 position) { Positions[index] = position; }
+void storeVelocity(uint index, vec2 velocity) { Velocities[index] = packHalf2x16(velocity); }
+
+#elif PARTICLE_LAYOUT == 3
+
+// std430 interleaved position and velocity in a single buffer (16 bytes per particle, AoS)
+
+struct Particle {
+    vec2 position;
+    vec2 velocity;
+};
+
+layout(std430, binding = 0) buffer Particles {
+    Particle particles[ ];
+};
+
+vec2 loadPosition(uint index) { return particles[index].position; }
+vec2 loadVelocity(uint index) { return particles[index].velocity; }
+void storePosition(uint index, vec2 position) { particles[index].position = position; }
+void storeVelocity(uint index, vec2 velocity) { particles[index].velocity = velocity; }
+
+#endif
@@ -0,0 +1,43 @@
+// Particle lifetimes, shared by the emitter passes and the simulation (PARTICLE_LIFETIME)
+// Particles are never moved, they are referenced through index lists:
+// - the dead list is a stack of free particle indices, the emitter pops from it and the simulation pushes expired particles back
+// - the alive list holds the indices of all live particles, the simulation appends the survivors to the next one
+// The counters share a buffer with the indirect dispatch and draw arguments, so the GPU sizes its own work
+// Buffer offsets must match the LIFETIME_* defines on the host
+
+// Remaining lifetime of each particle, in simulation time
+layout(std430, binding = 2) buffer Lifetimes {
+    float lifetimes[ ];
+};
+
+layout(std430, binding = 3) buffer DeadList {
+    uint deadIndices[ ];
+};
+
+layout(std430, binding = 4) buffer AliveList {
+    uint aliveIndices[ ];
+};
+
+layout(std430, binding = 5) buffer NextAliveList {
+    uint nextAliveIndices[ ];
+};
+
+layout(std430, binding = 6) buffer Counters {
+    // glDispatchComputeIndirect arguments of the emitter (offset 0) and the simulation (offset 12)
+    uint emitGroupsX;
+    uint emitGroupsY;
+    uint emitGroupsZ;
+    uint simulateGroupsX;
+    uint simulateGroupsY;
+    uint simulateGroupsZ;
+    // glDrawArraysIndirect arguments (offset 24)
+    uint drawCount;
+    uint drawInstanceCount;
+    uint drawFirst;
+    uint drawBaseInstance;
+    // Offset 40
+    uint deadCount;
+    uint aliveCount;
+    uint nextAliveCount;
+    uint emitCount;
+};
@@ -0,0 +1,70 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    Soft collisions between particles closer than SPATIAL_CELL_SIZE, found with the spatial hash
+    Only velocities are changed, positions of neighbors are read by other invocations and are moved
+    afterwards by the simulation shader
+*/
+
+#version 430
+
+#include "particle_buffers.glsl"
+#include "dispatch_index.glsl"
+#include "spatial_hash.glsl"
+
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+layout (location = 0) uniform float deltaT;
+layout (location = 1) uniform uint particleCount;
+// Strength of the push between two overlapping particles
+layout (location = 2) uniform float stiffness;
+
+void main() {
+
+    uint index = getLinearInvocationIndex();
+    if (index >= particleCount) {
+        return;
+    }
+
+    vec2 position = loadPosition(index);
+    vec2 push = vec2(0.0);
+    ivec2 cell = getHashCell(position);
+
+    // Cells around the particle may share a key, each key is only visited once
+    uint visitedKeys[9];
+    uint visitedCount = 0u;
+
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+
+            uint key = getCellKey(cell + ivec2(x, y));
+            bool visited = false;
+            for (uint i = 0u; i < visitedCount; i++) {
+                visited = visited || (visitedKeys[i] == key);
+            }
+            if (visited) {
+                continue;
+            }
+            visitedKeys[visitedCount++] = key;
+
+            uvec2 range = getCellRange(key);
+            for (uint j = range.x; j < range.y; j++) {
+                vec2 direction = position - loadPosition(j);
+                float distanceSqr = dot(direction, direction);
+                // Also skips the particle itself
+                if ((distanceSqr > 0.0) && (distanceSqr < SPATIAL_CELL_SIZE * SPATIAL_CELL_SIZE)) {
+                    float distance = sqrt(distanceSqr);
+                    push += direction / distance * (1.0 - distance / SPATIAL_CELL_SIZE);
+                }
+            }
+
+        }
+    }
+
+    storeVelocity(index, loadVelocity(index) + push * stiffness * deltaT);
+
+}
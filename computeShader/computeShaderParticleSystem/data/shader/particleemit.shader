@@ -0,0 +1,123 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    Particle emitter, see particle_lifetime.glsl
+    EMIT_PASS selects the pass:
+    0 : marks all particles of the pool as dead (one invocation per particle)
+    1 : clamps the requested number of new particles to the dead count and writes the emitter's dispatch arguments (single invocation)
+    2 : pops indices from the dead list and spawns new particles (indirect dispatch)
+    3 : writes the simulation's dispatch arguments for the alive count (single invocation)
+    4 : makes the survivors of the simulation the alive list and writes the draw arguments (single invocation)
+*/
+
+#version 430
+
+#include "particle_buffers.glsl"
+#include "particle_lifetime.glsl"
+#include "dispatch_index.glsl"
+
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+#ifndef EMIT_PASS
+#define EMIT_PASS 0
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+// Size of the particle pool
+layout (location = 0) uniform uint particleCount;
+layout (location = 1) uniform uint requestedCount;
+layout (location = 2) uniform vec2 emitterPos;
+layout (location = 3) uniform uint seed;
+// Maximum lifetime, new particles get between half and all of it
+layout (location = 4) uniform float lifetime;
+layout (location = 5) uniform uint simulationWorkgroupSize;
+// GL_MAX_COMPUTE_WORK_GROUP_COUNT in x, larger indirect dispatches are split over x and y
+layout (location = 6) uniform uint maxWorkGroupCountX;
+
+// Same hash as the reset shader
+uint pcgHash(uint value) {
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float toUnitFloat(uint value) {
+    return float(value >> 8u) * (1.0 / 16777216.0);
+}
+
+void main() {
+
+    uint id = getLinearInvocationIndex();
+
+#if EMIT_PASS == 0
+
+    if (id >= particleCount) {
+        return;
+    }
+    // Reversed, so the lowest indices are popped first
+    deadIndices[id] = particleCount - 1u - id;
+    lifetimes[id] = 0.0;
+    if (id == 0u) {
+        deadCount = particleCount;
+        aliveCount = 0u;
+        nextAliveCount = 0u;
+        emitCount = 0u;
+        drawCount = 0u;
+        drawInstanceCount = 1u;
+        drawFirst = 0u;
+        drawBaseInstance = 0u;
+    }
+
+#elif EMIT_PASS == 1
+
+    if (id == 0u) {
+        emitCount = min(requestedCount, deadCount);
+        uvec2 groups = splitWorkGroups((emitCount + WORKGROUP_SIZE - 1u) / WORKGROUP_SIZE, maxWorkGroupCountX);
+        emitGroupsX = groups.x;
+        emitGroupsY = groups.y;
+        emitGroupsZ = 1u;
+    }
+
+#elif EMIT_PASS == 2
+
+    if (id >= emitCount) {
+        return;
+    }
+    // The emit count never exceeds the dead count and nothing else pushes or pops during this pass
+    uint index = deadIndices[atomicAdd(deadCount, 0xFFFFFFFFu) - 1u];
+
+    uint hash = pcgHash(id ^ pcgHash(seed));
+    float angle = toUnitFloat(hash) * 6.28318531;
+    hash = pcgHash(hash);
+    float speed = toUnitFloat(hash) * 0.01;
+    hash = pcgHash(hash);
+    vec2 direction = vec2(cos(angle), sin(angle));
+
+    storePosition(index, emitterPos + direction * 0.02);
+    storeVelocity(index, direction * speed);
+    lifetimes[index] = lifetime * (0.5 + 0.5 * toUnitFloat(hash));
+    aliveIndices[atomicAdd(aliveCount, 1u)] = index;
+
+#elif EMIT_PASS == 3
+
+    if (id == 0u) {
+        uvec2 groups = splitWorkGroups((aliveCount + simulationWorkgroupSize - 1u) / simulationWorkgroupSize, maxWorkGroupCountX);
+        simulateGroupsX = groups.x;
+        simulateGroupsY = groups.y;
+        simulateGroupsZ = 1u;
+        nextAliveCount = 0u;
+    }
+
+#elif EMIT_PASS == 4
+
+    // The host swaps the two alive lists afterwards
+    if (id == 0u) {
+        aliveCount = nextAliveCount;
+        drawCount = nextAliveCount;
+    }
+
+#endif
+
+}
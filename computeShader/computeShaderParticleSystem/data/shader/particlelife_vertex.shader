@@ -0,0 +1,21 @@
+#version 430
+// Draws the live particles only, the vertex index selects a particle from the alive list
+// Vertex count comes from the draw arguments written by the emitter, see particle_lifetime.glsl
+
+#include "particle_buffers.glsl"
+
+layout(std430, binding = 4) readonly buffer AliveList {
+    uint aliveIndices[ ];
+};
+
+// Positions before the last simulation step, see vertex.shader
+layout(std430, binding = 7) readonly buffer PrevPos {
+    vec2 prevPositions[ ];
+};
+
+uniform float interpolation;
+
+void main () {
+  uint index = aliveIndices[gl_VertexID];
+  gl_Position = vec4 (mix(prevPositions[index], loadPosition(index), interpolation), 0.0, 1.0);
+}
@@ -0,0 +1,68 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    Gathers the particles in the order of their sorted cell keys into a second set of buffers
+    Particles of the same cell end up next to each other, which makes neighbor queries, the simulation and
+    rendering more cache friendly
+    Particles are copied as raw words, so this works for all storage layouts
+*/
+
+#version 430
+
+#include "dispatch_index.glsl"
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+// Size of a particle's position and velocity in 32 bit words (velocity is 0 for interleaved layouts)
+#ifndef POSITION_WORDS
+#define POSITION_WORDS 4
+#endif
+#ifndef VELOCITY_WORDS
+#define VELOCITY_WORDS 4
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+layout (location = 1) uniform uint particleCount;
+
+layout(std430, binding = 0) readonly buffer Pos {
+    uint positions[ ];
+};
+
+// Particle indices in sorted order
+layout(std430, binding = 4) readonly buffer Values {
+    uint values[ ];
+};
+
+layout(std430, binding = 5) writeonly buffer SortedPos {
+    uint sortedPositions[ ];
+};
+
+#if VELOCITY_WORDS > 0
+layout(std430, binding = 1) readonly buffer Vel {
+    uint velocities[ ];
+};
+
+layout(std430, binding = 6) writeonly buffer SortedVel {
+    uint sortedVelocities[ ];
+};
+#endif
+
+void main() {
+
+    uint index = getLinearInvocationIndex();
+    if (index >= particleCount) {
+        return;
+    }
+
+    uint source = values[index];
+    for (uint i = 0u; i < POSITION_WORDS; i++) {
+        sortedPositions[index * POSITION_WORDS + i] = positions[source * POSITION_WORDS + i];
+    }
+#if VELOCITY_WORDS > 0
+    for (uint i = 0u; i < VELOCITY_WORDS; i++) {
+        sortedVelocities[index * VELOCITY_WORDS + i] = velocities[source * VELOCITY_WORDS + i];
+    }
+#endif
+
+}
@@ -0,0 +1,54 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    Seeds a range of particles around a center point
+    Random numbers come from a stateless PCG hash of the particle index and a seed, so a reset
+    costs a single dispatch at any particle count and the same seed always gives the same result
+*/
+
+#version 430
+
+#include "particle_buffers.glsl"
+#include "dispatch_index.glsl"
+
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+layout (location = 0) uniform vec2 center;
+layout (location = 1) uniform float radius;
+layout (location = 2) uniform uint seed;
+// Range of particles to seed
+layout (location = 3) uniform uint firstParticle;
+layout (location = 4) uniform uint particleCount;
+
+// PCG hash (O'Neill, "PCG: A Family of Simple Fast Space-Efficient Statistically Good Algorithms for Random Number Generation")
+uint pcgHash(uint value) {
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Uniform float in [0, 1) from the upper 24 bits
+float toUnitFloat(uint value) {
+    return float(value >> 8u) * (1.0 / 16777216.0);
+}
+
+void main() {
+
+    uint id = getLinearInvocationIndex();
+    if (id >= particleCount) {
+        return;
+    }
+    uint index = firstParticle + id;
+
+    uint hash = pcgHash(index ^ pcgHash(seed));
+    float angle = toUnitFloat(hash) * 6.28318531;
+    float distance = toUnitFloat(pcgHash(hash)) * radius;
+
+    storePosition(index, center + vec2(cos(angle), sin(angle)) * distance);
+    storeVelocity(index, vec2(0.0));
+
+}
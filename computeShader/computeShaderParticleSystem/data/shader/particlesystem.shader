@@ -8,67 +8,129 @@
 
 #version 430
 
-
-// Target 0 : Vertex position
-layout(std140, binding = 0) buffer Pos {
-   vec4 Positions[ ];
-};
-
-// Target 1 : Vertex velocity
-layout(std140, binding = 1) buffer Vel {
-    vec4 Velocities[ ];
-};
-
-layout (local_size_x = 16, local_size_y = 16) in;
+// Compiled either as GLSL (with defines injected by the application) or offline to SPIR-V:
+//   glslangValidator -G -S comp -o particlesystem.comp.spv particlesystem.shader
+// In the SPIR-V module the workgroup size and feature toggles are specialization constants
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+
+#include "particle_buffers.glsl"
+#include "dispatch_index.glsl"
+
+// Particles with lifetimes are processed through the alive list, see particle_lifetime.glsl (GLSL only)
+#ifdef PARTICLE_LIFETIME
+#include "particle_lifetime.glsl"
+#endif
+
+#ifdef GL_SPIRV
+layout (local_size_x_id = 0) in;
+layout (constant_id = 1) const bool APPLY_GRAVITY = false;
+#else
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 16
+#endif
+#ifndef APPLY_GRAVITY
+#define APPLY_GRAVITY false
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+#endif
 
 // Gravity
-const vec3 gravity = vec3(0, -9.8f, 0);
+const vec2 gravity = vec2(0, -9.8f);
+
+// Explicit locations, SPIR-V programs are not required to keep uniform names
 
 // Frame delta for calculations
-uniform float deltaT;
-uniform vec3 destPos;
+layout (location = 0) uniform float deltaT;
+layout (location = 1) uniform vec2 destPos;
 
 // Viewport dimensions for border clamp
-uniform vec2 vpDim;
-uniform int borderClamp;
+layout (location = 2) uniform vec2 vpDim;
+layout (location = 3) uniform int borderClamp;
+
+// The last workgroup may extend past the end of the buffers
+layout (location = 4) uniform uint particleCount;
+
+// Number of steps of deltaT to take
+layout (location = 5) uniform uint substeps;
+
+// Position before the last step
+layout(std430, binding = 7) writeonly buffer PrevPos {
+    vec2 prevPositions[ ];
+};
 
 void main() {
 
+#ifdef PARTICLE_LIFETIME
+    // The dispatch is sized by the GPU from the alive count, the pool size bounds it if the counter is stale
+    uint slot = getLinearInvocationIndex();
+    if (slot >= min(aliveCount, particleCount)) {
+        return;
+    }
+    uint index = aliveIndices[slot];
+
+    // Expired particles go back to the dead list and are neither moved nor drawn
+    float life = lifetimes[index] - deltaT * float(substeps);
+    if (life <= 0.0) {
+        deadIndices[atomicAdd(deadCount, 1u)] = index;
+        return;
+    }
+    lifetimes[index] = life;
+#else
     // Current SSBO index
-    uint index = gl_GlobalInvocationID.x;
+    uint index = getLinearInvocationIndex();
+    if (index >= particleCount) {
+        return;
+    }
+#endif
 
     // Read position and velocity
 
-    vec3 vPos = Positions[index].xyz;
-    vec3 vVel = Velocities[index].xyz;
-
-    // Calculate new velocity depending on attraction point
-    vVel += normalize(destPos - vPos) * 0.001 * deltaT;
+    vec2 vPos = loadPosition(index);
+    vec2 vVel = loadVelocity(index);
 
-    // Move by velocity
-    vPos += vVel * deltaT;
+    // Fixed size substeps, all of a frame's steps are taken in one dispatch so each particle is read and written once
+    // The position before the last step is kept for interpolation when drawing
+    vec2 vPrevPos = vPos;
+    for (uint substep = 0u; substep < substeps; substep++) {
 
+        vPrevPos = vPos;
 
-    if (borderClamp == 1.0f) {
+        // Calculate new velocity depending on attraction point
+        vVel += normalize(destPos - vPos) * 0.001 * deltaT;
 
-        if (vPos.x < -vpDim.x) {
-            vPos.x = -vpDim.x;
-            vVel.x = -vVel.x;
+        // Constant branch, removed when the shader is specialized
+        if (APPLY_GRAVITY) {
+            vVel += gravity * 0.00001 * deltaT;
         }
 
-        if (vPos.x > vpDim.x) {
-            vPos.x = vpDim.x;
-            vVel.x = -vVel.x;
-        }
+        // Move by velocity
+        vPos += vVel * deltaT;
 
-        if (vPos.y < -vpDim.y) {
-            vPos.y = -vpDim.y;
-            vVel.y = -vVel.y;
-        }
 
-        if (vPos.y > vpDim.y) {
-            vPos.y = vpDim.y;
-            vVel.y = -vVel.y;
+        if (borderClamp == 1.0f) {
+
+            if (vPos.x < -vpDim.x) {
+                vPos.x = -vpDim.x;
+                vVel.x = -vVel.x;
+            }
+
+            if (vPos.x > vpDim.x) {
+                vPos.x = vpDim.x;
+                vVel.x = -vVel.x;
+            }
+
+            if (vPos.y < -vpDim.y) {
+                vPos.y = -vpDim.y;
+                vVel.y = -vVel.y;
+            }
+
+            if (vPos.y > vpDim.y) {
+                vPos.y = vpDim.y;
+                vVel.y = -vVel.y;
+            }
+
         }
 
     }
@@ -76,8 +138,13 @@ void main() {
     // Write back
 
 
-    Positions[index].xyz = vPos;
-    Velocities[index].xyz = vVel;
+    storePosition(index, vPos);
+    storeVelocity(index, vVel);
+    prevPositions[index] = vPrevPos;
+
+#ifdef PARTICLE_LIFETIME
+    nextAliveIndices[atomicAdd(nextAliveCount, 1u)] = index;
+#endif
 
 }
 
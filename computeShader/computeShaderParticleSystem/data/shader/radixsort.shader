@@ -0,0 +1,199 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    Stable least significant digit radix sort of key / value pairs, RADIX_BITS per pass
+    Each digit takes three dispatches, selected by RADIX_PASS:
+    0 : Counts the digits of each block of WORKGROUP_SIZE keys
+    1 : Exclusive prefix sum over all counts (digit major), giving the output offset of each digit in each block
+        Runs as a single workgroup
+    2 : Sorts each block locally by the digit (one bit at a time with split operations, which keeps it stable)
+        and scatters the keys to their block's offset for the digit
+    The application ping-pongs between two key / value buffers for each digit
+*/
+
+#version 430
+
+#include "dispatch_index.glsl"
+
+#define RADIX_BITS 4
+#define RADIX_BUCKETS (1u << RADIX_BITS)
+#define RADIX_MASK (RADIX_BUCKETS - 1u)
+
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+#define SCAN_WORKGROUP_SIZE 1024
+#ifndef RADIX_PASS
+#define RADIX_PASS 0
+#endif
+
+#if RADIX_PASS == 1
+layout (local_size_x = SCAN_WORKGROUP_SIZE) in;
+#else
+layout (local_size_x = WORKGROUP_SIZE) in;
+#endif
+
+layout (location = 0) uniform uint elementCount;
+// Position of the current digit
+layout (location = 1) uniform uint shift;
+// Number of blocks of WORKGROUP_SIZE keys
+layout (location = 2) uniform uint blockCount;
+
+layout(std430, binding = 3) buffer Keys {
+    uint keys[ ];
+};
+
+layout(std430, binding = 4) buffer Values {
+    uint values[ ];
+};
+
+layout(std430, binding = 5) buffer SortedKeys {
+    uint sortedKeys[ ];
+};
+
+layout(std430, binding = 6) buffer SortedValues {
+    uint sortedValues[ ];
+};
+
+// Digit counts, then offsets, of all blocks (index = digit * blockCount + block)
+layout(std430, binding = 7) buffer Histograms {
+    uint histograms[ ];
+};
+
+#if RADIX_PASS == 0
+
+shared uint digitCounts[RADIX_BUCKETS];
+
+void main() {
+
+    // Split dispatches may have workgroups past the last block
+    uint block = getLinearWorkGroupIndex();
+    if (block >= blockCount) {
+        return;
+    }
+
+    uint lid = gl_LocalInvocationID.x;
+    if (lid < RADIX_BUCKETS) {
+        digitCounts[lid] = 0u;
+    }
+    memoryBarrierShared();
+    barrier();
+
+    uint index = getLinearInvocationIndex();
+    if (index < elementCount) {
+        atomicAdd(digitCounts[(keys[index] >> shift) & RADIX_MASK], 1u);
+    }
+    memoryBarrierShared();
+    barrier();
+
+    if (lid < RADIX_BUCKETS) {
+        histograms[lid * blockCount + block] = digitCounts[lid];
+    }
+
+}
+
+#elif RADIX_PASS == 1
+
+shared uint partialSums[SCAN_WORKGROUP_SIZE];
+
+void main() {
+
+    // Each invocation sums up a contiguous range of the counts
+    uint lid = gl_LocalInvocationID.x;
+    uint total = RADIX_BUCKETS * blockCount;
+    uint rangeSize = (total + SCAN_WORKGROUP_SIZE - 1u) / SCAN_WORKGROUP_SIZE;
+    uint rangeStart = min(lid * rangeSize, total);
+    uint rangeEnd = min(rangeStart + rangeSize, total);
+    uint sum = 0u;
+    for (uint i = rangeStart; i < rangeEnd; i++) {
+        sum += histograms[i];
+    }
+
+    // Inclusive scan of the range sums (Hillis-Steele)
+    partialSums[lid] = sum;
+    memoryBarrierShared();
+    barrier();
+    for (uint offset = 1u; offset < SCAN_WORKGROUP_SIZE; offset <<= 1u) {
+        uint add = (lid >= offset) ? partialSums[lid - offset] : 0u;
+        barrier();
+        partialSums[lid] += add;
+        memoryBarrierShared();
+        barrier();
+    }
+
+    // Write the exclusive scan of the range
+    uint runningSum = partialSums[lid] - sum;
+    for (uint i = rangeStart; i < rangeEnd; i++) {
+        uint count = histograms[i];
+        histograms[i] = runningSum;
+        runningSum += count;
+    }
+
+}
+
+#else
+
+shared uint sharedKeys[WORKGROUP_SIZE];
+shared uint sharedValues[WORKGROUP_SIZE];
+shared uint sharedScan[WORKGROUP_SIZE];
+shared uint digitStart[RADIX_BUCKETS];
+
+void main() {
+
+    uint block = getLinearWorkGroupIndex();
+    if (block >= blockCount) {
+        return;
+    }
+
+    uint lid = gl_LocalInvocationID.x;
+    uint index = getLinearInvocationIndex();
+    uint validCount = min(elementCount - block * WORKGROUP_SIZE, WORKGROUP_SIZE);
+    // Padding keys have all bits set, so they always stay behind the valid keys of the block
+    uint key = (index < elementCount) ? keys[index] : 0xFFFFFFFFu;
+    uint value = (index < elementCount) ? values[index] : 0u;
+
+    for (uint bit = 0u; bit < RADIX_BITS; bit++) {
+
+        // Split: keys with the bit cleared go first, both halves keep their order
+        uint isZero = 1u - ((key >> (shift + bit)) & 1u);
+        sharedScan[lid] = isZero;
+        memoryBarrierShared();
+        barrier();
+        for (uint offset = 1u; offset < WORKGROUP_SIZE; offset <<= 1u) {
+            uint add = (lid >= offset) ? sharedScan[lid - offset] : 0u;
+            barrier();
+            sharedScan[lid] += add;
+            memoryBarrierShared();
+            barrier();
+        }
+        uint zerosBefore = sharedScan[lid] - isZero;
+        uint zeroCount = sharedScan[WORKGROUP_SIZE - 1u];
+        uint destination = (isZero == 1u) ? zerosBefore : zeroCount + lid - zerosBefore;
+
+        sharedKeys[destination] = key;
+        sharedValues[destination] = value;
+        memoryBarrierShared();
+        barrier();
+        key = sharedKeys[lid];
+        value = sharedValues[lid];
+        barrier();
+    }
+
+    // Keys are sorted by digit now, so each digit starts where it differs from the previous key
+    uint digit = (key >> shift) & RADIX_MASK;
+    if ((lid == 0u) || (digit != ((sharedKeys[lid - 1u] >> shift) & RADIX_MASK))) {
+        digitStart[digit] = lid;
+    }
+    memoryBarrierShared();
+    barrier();
+
+    if (lid < validCount) {
+        uint destination = histograms[digit * blockCount + block] + lid - digitStart[digit];
+        sortedKeys[destination] = key;
+        sortedValues[destination] = value;
+    }
+
+}
+
+#endif
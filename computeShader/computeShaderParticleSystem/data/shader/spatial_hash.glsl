@@ -0,0 +1,40 @@
+// Uniform grid spatial hash for neighbor queries
+// Particles are sorted by the hash key of their cell (radixsort.shader) and then reordered in memory,
+// so all particles of a cell are stored next to each other and cellStart / cellEnd give their index range
+// Cells are hashed (Teschner et al., "Optimized Spatial Hashing for Collision Detection of Deformable Objects"),
+// so the grid is unbounded, different cells may share a key
+
+#ifndef SPATIAL_HASH_BITS
+#define SPATIAL_HASH_BITS 16
+#endif
+#define SPATIAL_HASH_TABLE_SIZE (1u << SPATIAL_HASH_BITS)
+// Edge length of a cell, also the largest distance neighbors can be found at
+#ifndef SPATIAL_CELL_SIZE
+#define SPATIAL_CELL_SIZE 0.01
+#endif
+
+// Index ranges [start, end) into the sorted particles for each key, empty keys have start = end = 0
+layout(std430, binding = 5) buffer CellStart {
+    uint cellStart[ ];
+};
+
+layout(std430, binding = 6) buffer CellEnd {
+    uint cellEnd[ ];
+};
+
+ivec2 getHashCell(vec2 position) {
+    return ivec2(floor(position / SPATIAL_CELL_SIZE));
+}
+
+uint getCellKey(ivec2 cell) {
+    return ((uint(cell.x) * 73856093u) ^ (uint(cell.y) * 19349663u)) & (SPATIAL_HASH_TABLE_SIZE - 1u);
+}
+
+// Neighbor iteration:
+//   ivec2 cell = getHashCell(position);
+//   for each of the 3x3 cells around it: uvec2 range = getCellRange(getCellKey(cell + offset));
+//   for (uint j = range.x; j < range.y; j++) { ... loadPosition(j) ... }
+// Particles in the range may belong to another cell with the same key, so distances have to be checked
+uvec2 getCellRange(uint key) {
+    return uvec2(cellStart[key], cellEnd[key]);
+}
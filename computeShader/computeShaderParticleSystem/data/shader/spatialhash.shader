@@ -0,0 +1,59 @@
+/*
+	This code is licensed under the Mozilla Public License Version 2.0 (http://opensource.org/licenses/MPL-2.0)
+	 2014 by Sascha Willems - www.saschawillems.de
+
+    Spatial hash passes, selected by SPATIAL_PASS
+    0 : Writes the cell key and index of each particle for sorting
+    1 : Builds the index range of each key from the sorted keys (cell ranges are cleared by the application)
+*/
+
+#version 430
+
+#include "particle_buffers.glsl"
+#include "dispatch_index.glsl"
+#include "spatial_hash.glsl"
+
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 256
+#endif
+#ifndef SPATIAL_PASS
+#define SPATIAL_PASS 0
+#endif
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+layout (location = 1) uniform uint particleCount;
+
+layout(std430, binding = 3) buffer Keys {
+    uint keys[ ];
+};
+
+layout(std430, binding = 4) buffer Values {
+    uint values[ ];
+};
+
+void main() {
+
+    uint index = getLinearInvocationIndex();
+    if (index >= particleCount) {
+        return;
+    }
+
+#if SPATIAL_PASS == 0
+
+    keys[index] = getCellKey(getHashCell(loadPosition(index)));
+    values[index] = index;
+
+#else
+
+    // First and last particle of each run of equal keys
+    uint key = keys[index];
+    if ((index == 0u) || (keys[index - 1u] != key)) {
+        cellStart[key] = index;
+    }
+    if ((index == particleCount - 1u) || (keys[index + 1u] != key)) {
+        cellEnd[key] = index + 1u;
+    }
+
+#endif
+
+}
@@ -1,5 +1,9 @@
 #version 400
 in vec3 pos;
+// Position before the last simulation step, particles are drawn in between by the fraction of a step
+// that has passed since (1.0 draws the current position)
+in vec2 prevPos;
+uniform float interpolation;
 void main () {
-  gl_Position = vec4 (pos, 1.0);
+  gl_Position = vec4 (mix(prevPos, pos.xy, interpolation), pos.z, 1.0);
 }
\ No newline at end of file
@@ -8,6 +8,7 @@ to move the particles towards the target position
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <Windows.h>
 #include <time.h> 
 
@@ -21,30 +22,24 @@ to move the particles towards the target position
 #include <algorithm>
 
 #include "glRenderer.h"
+#include "../../base/shaderSourceManager.hpp"
 
 using namespace std;
 
-struct vertex4f {
-	GLfloat x, y, z, w;
-};
-
+// Resolves includes and reloads changed shader files
+ShaderSourceManager shaderSources;
+// Worker threads for the CPU simulation
+ThreadPool threadPool;
 
-string readFile(const char *fileName) 
+// Storage layouts of the particle buffers, see data/shader/particle_buffers.glsl
+const ParticleLayout particleLayouts[PARTICLE_LAYOUT_COUNT] =
 {
-	string fileContent;
-	ifstream fileStream(fileName, ios::in);
-	if (!fileStream.is_open()) {
-		printf("File %s not found\n", fileName);
-		return "";
-	}
-	string line = "";
-	while (!fileStream.eof()) {
-		getline(fileStream, line);
-		fileContent.append(line + "\n");
-	}
-	fileStream.close();
-	return fileContent;
-}
+	{ "std140 vec4", 16, 16, 4, 0 },
+	{ "std430 vec2", 8, 8, 2, 0 },
+	{ "std430 vec2, half velocity", 8, 4, 2, 0 },
+	{ "std430 interleaved (AoS)", 16, 0, 2, 16 },
+};
+
 
 GLuint loadBMPTexture(const char * fileName) 
 {
@@ -103,112 +98,637 @@ glRenderer::~glRenderer()
 {
 }
 
-void glRenderer::printProgramLog(GLuint program)
+void glRenderer::generateShaders()
 {
-	GLint result = GL_FALSE;
-	int logLength;
+	// Linked binaries are cached on disk, so only the first start has to compile from source
+	baseshader.cache = &programCache;
+	computeshader.cache = &programCache;
+	computeshader.addUniformAlias("deltaT", 0);
+	computeshader.addUniformAlias("destPos", 1);
+	computeshader.addUniformAlias("vpDim", 2);
+	computeshader.addUniformAlias("borderClamp", 3);
+	computeshader.addUniformAlias("particleCount", 4);
+	computeshader.addUniformAlias("substeps", 5);
+	// Both programs are compiled in the background, renderScene() starts drawing once they are ready
+	shaderSources.addProgram(baseshader, { { GL_VERTEX_SHADER, "data/shader/vertex.shader" }, { GL_FRAGMENT_SHADER, "data/shader/fragment.shader" } }, {}, compileManager);
+	if (computeSupported)
+	{
+		// The simulation prefers the offline compiled SPIR-V module, the GLSL source is used if it's not available
+		if (!GLEW_ARB_gl_spirv || !readSpirvFile("data/shader/particlesystem.comp.spv", simulationSpirv))
+		{
+			simulationSpirv.clear();
+		}
+		printf("Particle storage layout: %s\n", particleLayouts[particleLayout].name);
+		// Use the fastest workgroup size measured on this GPU and driver if the simulation has been tuned before
+		if (workgroupTuner.load("particlesystem", workgroupSize))
+		{
+			printf("Using tuned workgroup size %u\n", workgroupSize);
+		}
+		simulation = &getSimulationProgram(workgroupSize);
+		printf("Compute shader: %s, workgroup size %u\n", simulationSpirv.empty() ? "GLSL" : "SPIR-V", workgroupSize);
+		// Seeds particles on the GPU, resets fall back to the CPU until it's ready
+		resetShader.cache = &programCache;
+		resetProgram = &getResetProgram();
+		// N-body and spatial hash passes are compiled on first use
+		nbodyShader.cache = &programCache;
+		spatialShader.cache = &programCache;
+		emitShader.cache = &programCache;
+		lifetimeDrawShader.cache = &programCache;
+	}
+	programCache.printStats();
+	// Edited shader files (and their includes) are recompiled at runtime
+	shaderSources.startWatching();
+}
 
-	glGetProgramiv(program, GL_LINK_STATUS, &result);
-	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-	if (logLength > 0) {
-		GLchar* strInfoLog = new GLchar[logLength + 1];
-		glGetProgramInfoLog(program, logLength, NULL, strInfoLog);
-		printf("programlog: %s\n", strInfoLog);
-	};
+ShaderProgram& glRenderer::getSimulationProgram(uint32_t size, bool lifetime)
+{
+	// The workgroup size and feature toggles are specialization constants of the SPIR-V module
+	// The module is compiled offline for the default storage layout and without lifetimes only
+	if (!simulationSpirv.empty() && (particleLayout == PARTICLE_LAYOUT_VEC4) && !lifetime)
+	{
+		auto it = spirvSimulations.find(size);
+		if (it != spirvSimulations.end())
+		{
+			return it->second;
+		}
+		ShaderProgram &program = spirvSimulations[size];
+		program = computeshader.cloneSettings();
+		SpecializationConstants constants;
+		constants.set(0, size);
+		constants.set(1, applyGravity);
+		program.addStageBinary(GL_COMPUTE_SHADER, simulationSpirv, constants);
+		compileManager.add(program);
+		return program;
+	}
+	// and defines of the GLSL source
+	std::vector<std::string> defines = { "WORKGROUP_SIZE=" + std::to_string(size), std::string("APPLY_GRAVITY=") + (applyGravity ? "true" : "false"), "PARTICLE_LAYOUT=" + std::to_string(particleLayout) };
+	if (lifetime)
+	{
+		defines.push_back("PARTICLE_LIFETIME=1");
+	}
+	return shaderSources.getVariant(computeshader, { { GL_COMPUTE_SHADER, "data/shader/particlesystem.shader" } }, defines, compileManager);
 }
 
-void glRenderer::printShaderLog(GLuint shader)
+ShaderProgram& glRenderer::getResetProgram()
 {
-	GLint result = GL_FALSE;
-	int logLength;
+	std::vector<std::string> defines = { "WORKGROUP_SIZE=" + std::to_string(RESET_WORKGROUP_SIZE), "PARTICLE_LAYOUT=" + std::to_string(particleLayout) };
+	return shaderSources.getVariant(resetShader, { { GL_COMPUTE_SHADER, "data/shader/particlereset.shader" } }, defines, compileManager);
+}
 
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
-	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-	if (logLength > 0) {
-		GLchar* strInfoLog = new GLchar[logLength + 1];
-		glGetShaderInfoLog(shader, logLength, NULL, strInfoLog);
-		printf("shaderlog: %s\n", strInfoLog);
-	};
+void glRenderer::setSimulationUniforms(ShaderProgram &program, float deltaT, float destPosX, float destPosY, uint32_t substeps)
+{
+	program.setFloat("deltaT", deltaT);
+	program.setVec2("destPos", destPosX, destPosY);
+	program.setVec2("vpDim", 1, 1);
+	program.setInt("borderClamp", (int)borderEnabled);
+	program.setUInt("particleCount", (GLuint)particleCount);
+	program.setUInt("substeps", substeps);
 }
 
+// One invocation per element, shaders get a linear index from data/shader/dispatch_index.glsl and skip the tail
+// If there are more workgroups than the implementation allows in x, they are split into rows of equal size
+void glRenderer::dispatchParticles(GLuint count, GLuint size)
+{
+	GLuint groups = (count + size - 1) / size;
+	GLuint groupsY = std::max((groups + maxWorkGroupCountX - 1) / maxWorkGroupCountX, 1u);
+	glDispatchCompute((groups + groupsY - 1) / groupsY, groupsY, 1);
+}
 
-GLuint glRenderer::loadShader(const char* vertexShaderFile, const char* fragmentShaderFile)
+void glRenderer::dispatchSimulation(uint32_t size)
 {
-	GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-	GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, SSBOPrevPos);
+	dispatchParticles((GLuint)particleCount, size);
+}
 
-	// Read shaders
-	std::string vertShaderStr = readFile(vertexShaderFile);
-	std::string fragShaderStr = readFile(fragmentShaderFile);
-	const char *vertShaderSrc = vertShaderStr.c_str();
-	const char *fragShaderSrc = fragShaderStr.c_str();
+int glRenderer::getMaxParticleCount()
+{
+	if (maxStorageBlockSize == 0)
+	{
+		return MAX_PARTICLE_COUNT;
+	}
+	// Each particle buffer is a single shader storage block
+	const ParticleLayout &layout = particleLayouts[particleLayout];
+	GLint64 maxCount = maxStorageBlockSize / std::max(layout.positionSize, layout.velocitySize);
+	return (int)std::min(maxCount, (GLint64)MAX_PARTICLE_COUNT);
+}
 
-	GLint result = GL_FALSE;
-	int logLength;
+void glRenderer::autoTuneWorkgroupSize()
+{
+	std::vector<uint32_t> candidates = WorkgroupSizeTuner::getCandidates();
+	// Submit all variants first, so they are compiled in parallel
+	for (auto size : candidates)
+	{
+		getSimulationProgram(size);
+	}
+	compileManager.finishAll();
 
-	// Compile vertex shader
-	std::cout << "Compiling vertex shader." << std::endl;
-	glShaderSource(vertShader, 1, &vertShaderSrc, NULL);
-	glCompileShader(vertShader);
-	printShaderLog(vertShader);
+	printf("Tuning workgroup size for %d particles...\n", particleCount);
+	uint32_t bestSize = workgroupSize;
+	double bestTime = 0.0;
+	for (auto size : candidates)
+	{
+		ShaderProgram &program = getSimulationProgram(size);
+		if (!program.isLinked())
+		{
+			continue;
+		}
+		// A delta of zero does the full amount of work without moving the particles
+		stateCache.useProgram(program.program);
+		setSimulationUniforms(program, 0.0f, 0.0f, 0.0f);
+		double time = WorkgroupSizeTuner::measure([&]() { dispatchSimulation(size); glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT); }, 32);
+		printf("Workgroup size %4u: %.4f ms per dispatch\n", size, time);
+		if ((bestTime == 0.0) || (time < bestTime))
+		{
+			bestTime = time;
+			bestSize = size;
+		}
+	}
+	stateCache.useProgram(0);
 
-	// Compile fragment shader
-	std::cout << "Compiling fragment shader." << std::endl;
-	glShaderSource(fragShader, 1, &fragShaderSrc, NULL);
-	glCompileShader(fragShader);
-	printShaderLog(fragShader);
+	printf("Fastest workgroup size: %u\n", bestSize);
+	workgroupSize = bestSize;
+	simulation = &getSimulationProgram(workgroupSize);
+	workgroupTuner.store("particlesystem", workgroupSize);
+}
 
-	std::cout << "Linking program" << std::endl;
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vertShader);
-	glAttachShader(program, fragShader);
-	glLinkProgram(program);
-	printProgramLog(program);
+void glRenderer::setParticleLayout(int layout)
+{
+	// Buffers are recreated for the new layout, so all particles are reseeded
+	particleLayout = layout;
+	simulation = &getSimulationProgram(workgroupSize);
+	resetProgram = &getResetProgram();
+	compileManager.finishAll();
+	stateCache.deleteBuffers(1, &SSBOPos);
+	stateCache.deleteBuffers(1, &SSBOVel);
+	stateCache.deleteBuffers(1, &sortedPos);
+	stateCache.deleteBuffers(1, &sortedVel);
+	SSBOPos = 0;
+	SSBOVel = 0;
+	sortedPos = 0;
+	sortedVel = 0;
+	particleCapacity = 0;
+	sortedCapacity = 0;
+	int count = particleCount;
+	particleCount = 0;
+	resizeBuffers(count);
+	const ParticleLayout &info = particleLayouts[particleLayout];
+	printf("Particle storage layout: %s (%d bytes per particle)\n", info.name, info.positionSize + info.velocitySize);
+}
 
-	glDeleteShader(vertShader);
-	glDeleteShader(fragShader);
+void glRenderer::benchmarkLayouts()
+{
+	int originalLayout = particleLayout;
+	printf("Benchmarking storage layouts with %d particles...\n", particleCount);
+	for (int layout = 0; layout < PARTICLE_LAYOUT_COUNT; layout++)
+	{
+		setParticleLayout(layout);
+		if (!simulation->isLinked())
+		{
+			continue;
+		}
+		stateCache.useProgram(simulation->program);
+		setSimulationUniforms(*simulation, 0.0f, 0.0f, 0.0f);
+		double time = WorkgroupSizeTuner::measure([&]() { dispatchSimulation(workgroupSize); glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT); }, 32);
+		stateCache.useProgram(0);
+		// Each step reads and writes position and velocity once
+		int bytesPerParticle = particleLayouts[layout].positionSize + particleLayouts[layout].velocitySize;
+		double particlesPerSecond = (double)particleCount / (time / 1000.0);
+		printf("%-28s: %.4f ms per step, %.1f M particles/s, %d bytes per particle, %.1f GB/s\n", particleLayouts[layout].name, time, particlesPerSecond / 1000000.0, bytesPerParticle, particlesPerSecond * bytesPerParticle * 2.0 / 1000000000.0);
+	}
+	setParticleLayout(originalLayout);
+}
 
-	return program;
+ShaderProgram& glRenderer::getNBodyProgram(const std::string &fileName, uint32_t size, bool grid)
+{
+	std::vector<std::string> defines = { "WORKGROUP_SIZE=" + std::to_string(size), "PARTICLE_LAYOUT=" + std::to_string(particleLayout), "GRID_SIZE=" + std::to_string(NBODY_GRID_SIZE), std::string("NBODY_GRID=") + (grid ? "1" : "0") };
+	return shaderSources.getVariant(nbodyShader, { { GL_COMPUTE_SHADER, fileName } }, defines, compileManager);
 }
 
-GLuint glRenderer::loadComputeShader(const char* computeShaderFile) 
+void glRenderer::setSimulationMode(int mode)
 {
-	GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
+	const char* names[SIMULATION_MODE_COUNT] = { "attractor", "N-body (tiled)", "N-body (grid approximation)" };
+	simulationMode = mode;
+	nbodyTime = 0.0;
+	nbodyInteractions = 0.0;
+	nbodySteps = 0;
+	printf("Simulation mode: %s%s\n", names[simulationMode], (cpuSimulation && (simulationMode != SIMULATION_ATTRACTOR)) ? " (GPU only, switch with \"g\")" : "");
+}
 
-	// Read shaders
-	std::string computeShaderStr = readFile(computeShaderFile);
-	const char *computeShaderSrc = computeShaderStr.c_str();
+void glRenderer::setNBodyTileSize(uint32_t size)
+{
+	nbodyTileSize = size;
+	nbodyTime = 0.0;
+	nbodyInteractions = 0.0;
+	nbodySteps = 0;
+	printf("N-body tile size: %u\n", nbodyTileSize);
+}
 
-	GLint result = GL_FALSE;
-	int logLength;
+void glRenderer::stepNBody(float deltaT)
+{
+	bool grid = (simulationMode == SIMULATION_NBODY_GRID);
+	ShaderProgram &forces = getNBodyProgram("data/shader/nbody.shader", nbodyTileSize, grid);
+	ShaderProgram &integrate = getNBodyProgram("data/shader/nbody_integrate.shader", NBODY_WORKGROUP_SIZE, false);
+	ShaderProgram *bin = grid ? &getNBodyProgram("data/shader/nbody_bin.shader", NBODY_WORKGROUP_SIZE, false) : nullptr;
+	// Particles stand still until all passes have been compiled
+	if (!forces.isLinked() || !integrate.isLinked() || (bin && !bin->isLinked()))
+	{
+		return;
+	}
 
-	std::cout << "Compiling compute shader." << std::endl;
-	glShaderSource(computeShader, 1, &computeShaderSrc, NULL);
-	glCompileShader(computeShader);
+	if (nbodyFrame == 0)
+	{
+		glGenQueries(2, nbodyQueries);
+		nbodyReportTime = glfwGetTime();
+	}
+	// Collect the result of the query issued two frames ago before reusing it
+	uint32_t query = nbodyFrame % 2;
+	if (nbodyFrame >= 2)
+	{
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(nbodyQueries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(nbodyQueries[query], GL_QUERY_RESULT, &elapsed);
+			nbodyTime += (double)elapsed / 1000000000.0;
+			nbodyInteractions += nbodyQueryInteractions[query];
+			nbodySteps++;
+		}
+	}
+	nbodyQueryInteractions[query] = (double)particleCount * (grid ? (double)(NBODY_GRID_SIZE * NBODY_GRID_SIZE) : (double)particleCount);
+	nbodyFrame++;
+	glBeginQuery(GL_TIME_ELAPSED, nbodyQueries[query]);
 
-	printShaderLog(computeShader);
+	if (grid)
+	{
+		if (nbodyGrid == 0)
+		{
+			glGenBuffers(1, &nbodyGrid);
+			stateCache.bindBuffer(GL_SHADER_STORAGE_BUFFER, nbodyGrid);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, NBODY_GRID_SIZE * NBODY_GRID_SIZE * 4 * sizeof(GLint), NULL, GL_DYNAMIC_COPY);
+		}
+		// Zero all particle counts and offset sums, then add all particles
+		stateCache.bindBuffer(GL_SHADER_STORAGE_BUFFER, nbodyGrid);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, NULL);
+		stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, nbodyGrid);
+		stateCache.useProgram(bin->program);
+		bin->setUInt("particleCount", (GLuint)particleCount);
+		dispatchParticles((GLuint)particleCount, NBODY_WORKGROUP_SIZE);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
 
-	std::cout << "Linking program" << std::endl;
-	GLuint program = glCreateProgram();
-	glAttachShader(program, computeShader);
-	glLinkProgram(program);
-	printProgramLog(program);
-	
-	glDeleteShader(computeShader);
+	// Forces only change velocities, positions are read by all invocations
+	stateCache.useProgram(forces.program);
+	forces.setFloat("deltaT", deltaT);
+	forces.setUInt("particleCount", (GLuint)particleCount);
+	forces.setFloat("particleMass", nbodyGravity / (float)particleCount);
+	forces.setFloat("softeningSqr", nbodySoftening * nbodySoftening);
+	dispatchParticles((GLuint)particleCount, nbodyTileSize);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	stateCache.useProgram(integrate.program);
+	integrate.setFloat("deltaT", deltaT);
+	integrate.setUInt("particleCount", (GLuint)particleCount);
+	integrate.setVec2("vpDim", 1, 1);
+	integrate.setInt("borderClamp", (int)borderEnabled);
+	dispatchParticles((GLuint)particleCount, NBODY_WORKGROUP_SIZE);
+
+	stateCache.useProgram(0);
+	glEndQuery(GL_TIME_ELAPSED);
+
+	// New positions are drawn and read by the next step's force pass
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+	reportNBodyPerformance();
+}
 
-	return program;
+void glRenderer::reportNBodyPerformance()
+{
+	double time = glfwGetTime();
+	if ((time - nbodyReportTime < 2.0) || (nbodySteps == 0))
+	{
+		return;
+	}
+	double interactionsPerSecond = nbodyInteractions / nbodyTime;
+	printf("N-body (%s, %d particles, tile size %u): %.3f ms per step, %.2f G interactions/s, %.1f GFLOPS (%d flops per interaction)\n",
+		(simulationMode == SIMULATION_NBODY_GRID) ? "grid" : "tiled", particleCount, nbodyTileSize, nbodyTime / nbodySteps * 1000.0,
+		interactionsPerSecond / 1000000000.0, interactionsPerSecond * NBODY_FLOPS_PER_INTERACTION / 1000000000.0, NBODY_FLOPS_PER_INTERACTION);
+	nbodyReportTime = time;
+	nbodyTime = 0.0;
+	nbodyInteractions = 0.0;
+	nbodySteps = 0;
+}
 
+// Half precision conversion as done by packHalf2x16 / unpackHalf2x16 (round to nearest even, with denormals)
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	if ((bits & 0x7FFFFFFF) > 0x7F800000)
+	{
+		return (uint16_t)(sign | 0x7E00);
+	}
+	if (exponent >= 31)
+	{
+		return (uint16_t)(sign | 0x7C00);
+	}
+	// Values below half of the smallest denormal round to zero
+	if (exponent < -10)
+	{
+		return (uint16_t)sign;
+	}
+	uint32_t half;
+	uint32_t shift;
+	if (exponent <= 0)
+	{
+		// Denormal, the implicit leading one becomes part of the mantissa
+		mantissa |= 0x800000;
+		shift = 14 - exponent;
+		half = sign | (mantissa >> shift);
+	}
+	else
+	{
+		shift = 13;
+		half = sign | ((uint32_t)exponent << 10) | (mantissa >> shift);
+	}
+	// All dropped bits decide the rounding, ties go to the even result
+	// A carry out of the mantissa correctly moves on to the next exponent (or to infinity)
+	uint32_t remainder = mantissa & ((1u << shift) - 1);
+	uint32_t halfway = 1u << (shift - 1);
+	if ((remainder > halfway) || ((remainder == halfway) && (half & 1)))
+	{
+		half++;
+	}
+	return (uint16_t)half;
 }
 
-void glRenderer::generateShaders()
+float halfToFloat(uint16_t value)
 {
-	baseshader = loadShader("data/shader/vertex.shader", "data/shader/fragment.shader");
-	computeshader = loadComputeShader("data/shader/particlesystem.shader");
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	if (exponent == 0)
+	{
+		float denormal = ldexpf((float)mantissa, -24);
+		return sign ? -denormal : denormal;
+	}
+	uint32_t bits = sign | ((exponent == 31) ? (0x7F800000 | (mantissa << 13)) : (((exponent - 15 + 127) << 23) | (mantissa << 13)));
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void glRenderer::downloadParticles(CpuParticleSystem &particles)
+{
+	const ParticleLayout &layout = particleLayouts[particleLayout];
+	std::vector<GLubyte> positions((size_t)particleCount * layout.positionSize);
+	std::vector<GLubyte> velocities((size_t)particleCount * layout.velocitySize);
+	// Make sure the compute shader's writes are visible to the read back
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	stateCache.bindBuffer(GL_COPY_READ_BUFFER, SSBOPos);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, positions.size(), positions.data());
+	if (layout.velocitySize > 0)
+	{
+		stateCache.bindBuffer(GL_COPY_READ_BUFFER, SSBOVel);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, velocities.size(), velocities.data());
+	}
+
+	particles.resize(particleCount);
+	for (int i = 0; i < particleCount; i++)
+	{
+		const GLfloat* position = (const GLfloat*)&positions[(size_t)i * layout.positionSize];
+		particles.positionsX[i] = position[0];
+		particles.positionsY[i] = position[1];
+		if (particleLayout == PARTICLE_LAYOUT_AOS)
+		{
+			// Velocity is stored right after the position
+			particles.velocitiesX[i] = position[2];
+			particles.velocitiesY[i] = position[3];
+		}
+		else if (particleLayout == PARTICLE_LAYOUT_HALF_VELOCITY)
+		{
+			uint32_t packed;
+			memcpy(&packed, &velocities[(size_t)i * layout.velocitySize], sizeof(packed));
+			particles.velocitiesX[i] = halfToFloat((uint16_t)(packed & 0xFFFF));
+			particles.velocitiesY[i] = halfToFloat((uint16_t)(packed >> 16));
+		}
+		else
+		{
+			const GLfloat* velocity = (const GLfloat*)&velocities[(size_t)i * layout.velocitySize];
+			particles.velocitiesX[i] = velocity[0];
+			particles.velocitiesY[i] = velocity[1];
+		}
+	}
+}
+
+void glRenderer::uploadParticles(const CpuParticleSystem &particles)
+{
+	const ParticleLayout &layout = particleLayouts[particleLayout];
+	std::vector<GLubyte> positions((size_t)particleCount * layout.positionSize);
+	std::vector<GLubyte> velocities((size_t)particleCount * layout.velocitySize);
+	for (int i = 0; i < particleCount; i++)
+	{
+		GLfloat* position = (GLfloat*)&positions[(size_t)i * layout.positionSize];
+		position[0] = particles.positionsX[i];
+		position[1] = particles.positionsY[i];
+		if (particleLayout == PARTICLE_LAYOUT_VEC4)
+		{
+			GLfloat* velocity = (GLfloat*)&velocities[(size_t)i * layout.velocitySize];
+			position[2] = 0.0f;
+			position[3] = 1.0f;
+			velocity[0] = particles.velocitiesX[i];
+			velocity[1] = particles.velocitiesY[i];
+			velocity[2] = 0.0f;
+			velocity[3] = 1.0f;
+		}
+		else if (particleLayout == PARTICLE_LAYOUT_AOS)
+		{
+			position[2] = particles.velocitiesX[i];
+			position[3] = particles.velocitiesY[i];
+		}
+		else if (particleLayout == PARTICLE_LAYOUT_HALF_VELOCITY)
+		{
+			uint32_t packed = (uint32_t)floatToHalf(particles.velocitiesX[i]) | ((uint32_t)floatToHalf(particles.velocitiesY[i]) << 16);
+			memcpy(&velocities[(size_t)i * layout.velocitySize], &packed, sizeof(packed));
+		}
+		else
+		{
+			GLfloat* velocity = (GLfloat*)&velocities[(size_t)i * layout.velocitySize];
+			velocity[0] = particles.velocitiesX[i];
+			velocity[1] = particles.velocitiesY[i];
+		}
+	}
+	// Don't overwrite particles the compute shader may still be working on
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	stateCache.bindBuffer(GL_COPY_WRITE_BUFFER, SSBOPos);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, positions.size(), positions.data());
+	if (layout.velocitySize > 0)
+	{
+		stateCache.bindBuffer(GL_COPY_WRITE_BUFFER, SSBOVel);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, velocities.size(), velocities.data());
+	}
+}
+
+void glRenderer::setCpuSimulation(bool enabled)
+{
+	if (!computeSupported)
+	{
+		printf("Compute shaders are not supported, particles can only be simulated on the CPU\n");
+		return;
+	}
+	// The particle state moves along, so switching doesn't reset the particles
+	if (enabled)
+	{
+		downloadParticles(cpuParticles);
+	}
+	else
+	{
+		uploadParticles(cpuParticles);
+	}
+	cpuSimulation = enabled;
+	if (cpuSimulation)
+	{
+		printf("Simulation: CPU (%s, %u threads)\n", CpuParticleSystem::getSimdLevelName(cpuParticles.simdLevel), threadPool.getThreadCount());
+	}
+	else
+	{
+		printf("Simulation: GPU\n");
+	}
 }
 
-void glRenderer::resetPositionSSBO()
+GLuint glRenderer::updateCpuSimulation(float deltaT, uint32_t substeps, float destPosX, float destPosY, GLintptr &vertexOffset)
 {
+	CpuParticleSystem::Params params;
+	params.deltaT = deltaT;
+	params.destPosX = destPosX;
+	params.destPosY = destPosY;
+	params.borderClamp = borderEnabled;
+	params.applyGravity = applyGravity;
+	GLsizeiptr size = (GLsizeiptr)particleCount * 2 * sizeof(GLfloat);
+
+	// Only the last step writes vertices, a frame without a step writes the current positions with a step of zero
+	if (substeps == 0)
+	{
+		params.deltaT = 0.0f;
+	}
+	for (uint32_t i = 1; i < substeps; i++)
+	{
+		cpuParticles.update(threadPool, params, nullptr);
+	}
+
+	if (StreamingBuffer::isSupported())
+	{
+		// The simulation writes the positions straight into a persistently mapped buffer, one region per frame in flight
+		if (!cpuVertexStream.isCreated() || (size > cpuVertexStreamSize))
+		{
+			cpuVertexStream.destroy();
+			cpuVertexStreamSize = std::max(size, cpuVertexStreamSize * 2);
+			cpuVertexStream.create(GL_ARRAY_BUFFER, cpuVertexStreamSize);
+			// The streaming buffer binds (and unbinds) itself
+			stateCache.invalidateBuffer(GL_ARRAY_BUFFER);
+		}
+		StreamingBuffer::Allocation allocation = cpuVertexStream.allocate(size);
+		cpuParticles.update(threadPool, params, (float*)allocation.pointer);
+		vertexOffset = allocation.offset;
+		return cpuVertexStream.getBuffer();
+	}
+
+	// Without buffer storage the positions are uploaded every frame
+	cpuVertices.resize((size_t)particleCount * 2);
+	cpuParticles.update(threadPool, params, cpuVertices.data());
+	if (cpuVertexBuffer == 0)
+	{
+		glGenBuffers(1, &cpuVertexBuffer);
+	}
+	stateCache.bindBuffer(GL_ARRAY_BUFFER, cpuVertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, size, cpuVertices.data(), GL_STREAM_DRAW);
+	vertexOffset = 0;
+	return cpuVertexBuffer;
+}
+
+void glRenderer::verifyGpuSimulation()
+{
+	if (!simulation->isLinked())
+	{
+		return;
+	}
+	if (lifetimes)
+	{
+		printf("Verification runs the simulation without lifetimes, dead particles are compared too\n");
+	}
 
+	// The check runs a real step on the particle buffers, so their contents are saved and restored afterwards
+	const ParticleLayout &layout = particleLayouts[particleLayout];
+	GLsizeiptr backupSize[2] = { (GLsizeiptr)particleCount * layout.positionSize, (GLsizeiptr)particleCount * layout.velocitySize };
+	GLuint liveBuffers[2] = { SSBOPos, SSBOVel };
+	GLuint backupBuffers[2] = { 0, 0 };
+	glGenBuffers(2, backupBuffers);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (backupSize[i] > 0)
+		{
+			stateCache.bindBuffer(GL_COPY_WRITE_BUFFER, backupBuffers[i]);
+			glBufferData(GL_COPY_WRITE_BUFFER, backupSize[i], NULL, GL_STATIC_COPY);
+			stateCache.bindBuffer(GL_COPY_READ_BUFFER, liveBuffers[i]);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, backupSize[i]);
+		}
+	}
+
+	// Both simulations start from the same state
+	if (cpuSimulation)
+	{
+		uploadParticles(cpuParticles);
+	}
+	CpuParticleSystem reference;
+	downloadParticles(reference);
+
+	// Fixed parameters, so the result doesn't depend on frame time and cursor position
+	CpuParticleSystem::Params params;
+	params.deltaT = 0.25f;
+	params.destPosX = 0.3f;
+	params.destPosY = -0.2f;
+	params.borderClamp = borderEnabled;
+	params.applyGravity = applyGravity;
+	stateCache.useProgram(simulation->program);
+	setSimulationUniforms(*simulation, params.deltaT, params.destPosX, params.destPosY);
+	dispatchSimulation(workgroupSize);
+	stateCache.useProgram(0);
+	CpuParticleSystem gpuResult;
+	downloadParticles(gpuResult);
+
+	// Put the running simulation back to where it was
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (backupSize[i] > 0)
+		{
+			stateCache.bindBuffer(GL_COPY_READ_BUFFER, backupBuffers[i]);
+			stateCache.bindBuffer(GL_COPY_WRITE_BUFFER, liveBuffers[i]);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, backupSize[i]);
+		}
+	}
+	stateCache.deleteBuffers(2, backupBuffers);
+
+	reference.update(threadPool, params, nullptr);
+	// GPUs may use approximations for the square root and division in normalize, half precision velocities are rounded
+	float velocityTolerance = (particleLayout == PARTICLE_LAYOUT_HALF_VELOCITY) ? 1e-4f : 1e-6f;
+	CpuParticleSystem::Comparison comparison = reference.compare(gpuResult, 1e-5f, velocityTolerance);
+	printf("GPU simulation (%s) vs. CPU reference (%s), %d particles: %s\n", particleLayouts[particleLayout].name, CpuParticleSystem::getSimdLevelName(cpuParticles.simdLevel), particleCount, (comparison.mismatches == 0) ? "passed" : "FAILED");
+	printf("max. error position %g, velocity %g\n", comparison.maxPositionError, comparison.maxVelocityError);
+	if (comparison.mismatches > 0)
+	{
+		uint32_t i = comparison.firstMismatch;
+		printf("%u particles outside of tolerance, first one is %u: CPU pos (%f, %f) vel (%g, %g), GPU pos (%f, %f) vel (%g, %g)\n", comparison.mismatches, i,
+			reference.positionsX[i], reference.positionsY[i], reference.velocitiesX[i], reference.velocitiesY[i],
+			gpuResult.positionsX[i], gpuResult.positionsY[i], gpuResult.velocitiesX[i], gpuResult.velocitiesY[i]);
+	}
+}
+
+void glRenderer::getResetPosition(float &destPosX, float &destPosY)
+{
 	// Reset to mouse cursor pos
 	double cursorX, cursorY;
 	int windowWidth, windowHeight;
@@ -216,40 +736,448 @@ void glRenderer::resetPositionSSBO()
 	glfwGetCursorPos(window, &cursorX, &cursorY);
 	glfwGetWindowSize(window, &windowWidth, &windowHeight);
 
-	float destPosX = (float)(cursorX / (windowWidth)-0.5f) * 2.0f;
-	float destPosY = (float)((windowHeight - cursorY) / windowHeight - 0.5f) * 2.0f;
+	destPosX = (float)(cursorX / (windowWidth)-0.5f) * 2.0f;
+	destPosY = (float)((windowHeight - cursorY) / windowHeight - 0.5f) * 2.0f;
+}
 
-	struct vertex4f* verticesPos = (struct vertex4f*) glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, particleCount * sizeof(vertex4f), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-	for (int i = 0; i < particleCount; i++) {
+void glRenderer::resetPositionSSBO(int first, int count)
+{
+	float destPosX, destPosY;
+	getResetPosition(destPosX, destPosY);
+
+	// Only the given range is written, particles outside of it keep their state
+	const ParticleLayout &layout = particleLayouts[particleLayout];
+	GLubyte* verticesPos = (GLubyte*) glMapBufferRange(GL_SHADER_STORAGE_BUFFER, (GLintptr)first * layout.positionSize, (GLsizeiptr)count * layout.positionSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	for (int i = 0; i < count; i++) {
 		float rnd = (float)rand() / (float)(RAND_MAX);
 		float rndVal = (float)rand() / (float)(RAND_MAX / (360.0f * 3.14f * 2.0f));
 		float rndRad = (float)rand() / (float)(RAND_MAX)* 0.2f; // TODO : Change multiplier to get cool effects (e.g. wider range)
-		verticesPos[i].x = destPosX + cos(rndVal) * rndRad;
-		verticesPos[i].y = destPosY + sin(rndVal) * rndRad;
-		verticesPos[i].z = 0.0f;
-		verticesPos[i].w = 1.0f;
+		GLfloat* vertexPos = (GLfloat*)(verticesPos + (size_t)i * layout.positionSize);
+		vertexPos[0] = destPosX + cos(rndVal) * rndRad;
+		vertexPos[1] = destPosY + sin(rndVal) * rndRad;
+		// z and w for vec4 positions, velocity for interleaved particles
+		if (layout.positionSize == 16) {
+			vertexPos[2] = 0.0f;
+			vertexPos[3] = (particleLayout == PARTICLE_LAYOUT_VEC4) ? 1.0f : 0.0f;
+		}
 	}
 	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
 }
 
-void glRenderer::resetVelocitySSBO()
+void glRenderer::resetVelocitySSBO(int first, int count)
 {
-	struct vertex4f* verticesVel = (struct vertex4f*) glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, particleCount * sizeof(vertex4f), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-	for (int i = 0; i < particleCount; i++) {
-		verticesVel[i].x = 0.0f;
-		verticesVel[i].y = 0.0f;
-		verticesVel[i].z = 0.0f;
-		verticesVel[i].w = 1.0f;
-	}
+	// All zero bits are a zero velocity in all layouts (including half floats)
+	const ParticleLayout &layout = particleLayouts[particleLayout];
+	GLubyte* verticesVel = (GLubyte*) glMapBufferRange(GL_SHADER_STORAGE_BUFFER, (GLintptr)first * layout.velocitySize, (GLsizeiptr)count * layout.velocitySize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	memset(verticesVel, 0, (size_t)count * layout.velocitySize);
 	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
 }
 
+void glRenderer::seedParticles(int first, int count)
+{
+	if (!resetProgram || !resetProgram->isLinked())
+	{
+		stateCache.bindBuffer(GL_SHADER_STORAGE_BUFFER, SSBOPos);
+		resetPositionSSBO(first, count);
+		if (particleLayouts[particleLayout].velocitySize > 0)
+		{
+			stateCache.bindBuffer(GL_SHADER_STORAGE_BUFFER, SSBOVel);
+			resetVelocitySSBO(first, count);
+		}
+		return;
+	}
+
+	// Single dispatch, the seed is advanced on every reset so each one gives a new (but reproducible) distribution
+	float destPosX, destPosY;
+	getResetPosition(destPosX, destPosY);
+	stateCache.useProgram(resetProgram->program);
+	resetProgram->setVec2("center", destPosX, destPosY);
+	resetProgram->setFloat("radius", 0.2f);
+	resetProgram->setUInt("seed", resetSeed++);
+	resetProgram->setUInt("firstParticle", (GLuint)first);
+	resetProgram->setUInt("particleCount", (GLuint)count);
+	dispatchParticles((GLuint)count, RESET_WORKGROUP_SIZE);
+	stateCache.useProgram(0);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void glRenderer::seedCpuParticles(int first, int count)
+{
+	// Same distribution as the reset shader
+	float destPosX, destPosY;
+	getResetPosition(destPosX, destPosY);
+	cpuParticles.seed((uint32_t)first, (uint32_t)count, destPosX, destPosY, 0.2f, resetSeed++);
+}
+
 void glRenderer::resetBuffers()
 {
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBOPos);
-	resetPositionSSBO();
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBOVel);
-	resetVelocitySSBO();
+	if (cpuSimulation)
+	{
+		seedCpuParticles(0, particleCount);
+		return;
+	}
+	seedParticles(0, particleCount);
+	lifetimeReset = true;
+	interpolationValid = false;
+}
+
+// Creates a new buffer with the given capacity and copies the first particles over from the old one (if any)
+GLuint growBuffer(GLStateCache &stateCache, GLuint oldBuffer, GLsizeiptr copySize, GLsizeiptr capacity)
+{
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	stateCache.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+	if ((oldBuffer != 0) && (copySize > 0))
+	{
+		// GPU side copy, the particles never leave video memory
+		stateCache.bindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, copySize);
+	}
+	if (oldBuffer != 0)
+	{
+		stateCache.deleteBuffers(1, &oldBuffer);
+	}
+	return buffer;
+}
+
+ShaderProgram& glRenderer::getSpatialProgram(const std::string &fileName, const std::vector<std::string> &passDefines, bool particleAccess)
+{
+	std::vector<std::string> defines = passDefines;
+	defines.push_back("WORKGROUP_SIZE=" + std::to_string(SORT_WORKGROUP_SIZE));
+	defines.push_back("SPATIAL_HASH_BITS=" + std::to_string(SPATIAL_HASH_BITS));
+	defines.push_back("SPATIAL_CELL_SIZE=" + std::to_string(SPATIAL_CELL_SIZE));
+	// The radix sort doesn't touch particles, so it's shared by all storage layouts
+	if (particleAccess)
+	{
+		const ParticleLayout &layout = particleLayouts[particleLayout];
+		defines.push_back("PARTICLE_LAYOUT=" + std::to_string(particleLayout));
+		defines.push_back("POSITION_WORDS=" + std::to_string(layout.positionSize / 4));
+		defines.push_back("VELOCITY_WORDS=" + std::to_string(layout.velocitySize / 4));
+	}
+	return shaderSources.getVariant(spatialShader, { { GL_COMPUTE_SHADER, fileName } }, defines, compileManager);
+}
+
+bool glRenderer::sortParticles()
+{
+	ShaderProgram &hashPass = getSpatialProgram("data/shader/spatialhash.shader", { "SPATIAL_PASS=0" }, true);
+	ShaderProgram &cellPass = getSpatialProgram("data/shader/spatialhash.shader", { "SPATIAL_PASS=1" }, true);
+	ShaderProgram &reorderPass = getSpatialProgram("data/shader/particlereorder.shader", {}, true);
+	ShaderProgram &countPass = getSpatialProgram("data/shader/radixsort.shader", { "RADIX_PASS=0" }, false);
+	ShaderProgram &scanPass = getSpatialProgram("data/shader/radixsort.shader", { "RADIX_PASS=1" }, false);
+	ShaderProgram &scatterPass = getSpatialProgram("data/shader/radixsort.shader", { "RADIX_PASS=2" }, false);
+	ShaderProgram* radixPasses[3] = { &countPass, &scanPass, &scatterPass };
+	if (!hashPass.isLinked() || !cellPass.isLinked() || !reorderPass.isLinked() || !countPass.isLinked() || !scanPass.isLinked() || !scatterPass.isLinked())
+	{
+		return false;
+	}
+
+	// Sort buffers grow along with the particle buffers, their contents don't need to be kept
+	const ParticleLayout &layout = particleLayouts[particleLayout];
+	if (sortCapacity < particleCapacity)
+	{
+		GLsizeiptr capacityBlocks = (particleCapacity + SORT_WORKGROUP_SIZE - 1) / SORT_WORKGROUP_SIZE;
+		for (int i = 0; i < 2; i++)
+		{
+			sortKeys[i] = growBuffer(stateCache, sortKeys[i], 0, (GLsizeiptr)particleCapacity * sizeof(GLuint));
+			sortValues[i] = growBuffer(stateCache, sortValues[i], 0, (GLsizeiptr)particleCapacity * sizeof(GLuint));
+		}
+		sortHistograms = growBuffer(stateCache, sortHistograms, 0, (1 << RADIX_BITS) * capacityBlocks * sizeof(GLuint));
+		sortCapacity = particleCapacity;
+	}
+	if (sortedCapacity < particleCapacity)
+	{
+		sortedPos = growBuffer(stateCache, sortedPos, 0, (GLsizeiptr)particleCapacity * layout.positionSize);
+		if (layout.velocitySize > 0)
+		{
+			sortedVel = growBuffer(stateCache, sortedVel, 0, (GLsizeiptr)particleCapacity * layout.velocitySize);
+		}
+		sortedCapacity = particleCapacity;
+	}
+	if (cellStart == 0)
+	{
+		cellStart = growBuffer(stateCache, 0, 0, (1 << SPATIAL_HASH_BITS) * sizeof(GLuint));
+		cellEnd = growBuffer(stateCache, 0, 0, (1 << SPATIAL_HASH_BITS) * sizeof(GLuint));
+	}
+
+	GLuint blockCount = (particleCount + SORT_WORKGROUP_SIZE - 1) / SORT_WORKGROUP_SIZE;
+
+	// Cell key and index of each particle
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, sortKeys[0]);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, sortValues[0]);
+	stateCache.useProgram(hashPass.program);
+	hashPass.setUInt("particleCount", (GLuint)particleCount);
+	dispatchParticles((GLuint)particleCount, SORT_WORKGROUP_SIZE);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// Sort by key, one digit at a time, ping-ponging between the key / value buffers
+	uint32_t current = 0;
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, sortHistograms);
+	for (uint32_t shift = 0; shift < SPATIAL_HASH_BITS; shift += RADIX_BITS)
+	{
+		stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, sortKeys[current]);
+		stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, sortValues[current]);
+		stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, sortKeys[1 - current]);
+		stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, sortValues[1 - current]);
+		for (auto pass : radixPasses)
+		{
+			stateCache.useProgram(pass->program);
+			pass->setUInt("elementCount", (GLuint)particleCount);
+			pass->setUInt("shift", shift);
+			pass->setUInt("blockCount", blockCount);
+			// The prefix sum runs in a single workgroup
+			if (pass == &scanPass)
+			{
+				glDispatchCompute(1, 1, 1);
+			}
+			else
+			{
+				dispatchParticles((GLuint)particleCount, SORT_WORKGROUP_SIZE);
+			}
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+		current = 1 - current;
+	}
+
+	// Gather the particles in key order, then swap with the current particle buffers
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, sortValues[current]);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, sortedPos);
+	if (layout.velocitySize > 0)
+	{
+		stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, sortedVel);
+	}
+	stateCache.useProgram(reorderPass.program);
+	reorderPass.setUInt("particleCount", (GLuint)particleCount);
+	dispatchParticles((GLuint)particleCount, SORT_WORKGROUP_SIZE);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	std::swap(SSBOPos, sortedPos);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBOPos);
+	if (layout.velocitySize > 0)
+	{
+		std::swap(SSBOVel, sortedVel);
+		stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, SSBOVel);
+	}
+
+	// Index range of each key, keys without particles stay empty
+	stateCache.bindBuffer(GL_SHADER_STORAGE_BUFFER, cellStart);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	stateCache.bindBuffer(GL_SHADER_STORAGE_BUFFER, cellEnd);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, sortKeys[current]);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, cellStart);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, cellEnd);
+	stateCache.useProgram(cellPass.program);
+	cellPass.setUInt("particleCount", (GLuint)particleCount);
+	dispatchParticles((GLuint)particleCount, SORT_WORKGROUP_SIZE);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	stateCache.useProgram(0);
+	return true;
+}
+
+void glRenderer::collideParticles(float deltaT)
+{
+	ShaderProgram &collide = getSpatialProgram("data/shader/particlecollide.shader", {}, true);
+	if (!collide.isLinked() || !sortParticles())
+	{
+		return;
+	}
+	// Cell ranges are still bound by the sort
+	stateCache.useProgram(collide.program);
+	collide.setFloat("deltaT", deltaT);
+	collide.setUInt("particleCount", (GLuint)particleCount);
+	collide.setFloat("stiffness", collisionStiffness);
+	dispatchParticles((GLuint)particleCount, SORT_WORKGROUP_SIZE);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	stateCache.useProgram(0);
+}
+
+ShaderProgram& glRenderer::getEmitProgram(int pass)
+{
+	std::vector<std::string> defines = { "WORKGROUP_SIZE=" + std::to_string(EMIT_WORKGROUP_SIZE), "PARTICLE_LAYOUT=" + std::to_string(particleLayout), "EMIT_PASS=" + std::to_string(pass) };
+	return shaderSources.getVariant(emitShader, { { GL_COMPUTE_SHADER, "data/shader/particleemit.shader" } }, defines, compileManager);
+}
+
+ShaderProgram& glRenderer::getLifetimeDrawProgram()
+{
+	std::vector<std::string> defines = { "PARTICLE_LAYOUT=" + std::to_string(particleLayout) };
+	return shaderSources.getVariant(lifetimeDrawShader, { { GL_VERTEX_SHADER, "data/shader/particlelife_vertex.shader" }, { GL_FRAGMENT_SHADER, "data/shader/fragment.shader" } }, defines, compileManager);
+}
+
+void glRenderer::setLifetimes(bool enabled)
+{
+	// Live particles are drawn through the alive list, which is read in the vertex shader
+	GLint vertexStorageBlocks = 0;
+	glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexStorageBlocks);
+	if (enabled && (vertexStorageBlocks < 3))
+	{
+		printf("Particle lifetimes need shader storage buffers in vertex shaders (supported: %d)\n", vertexStorageBlocks);
+		return;
+	}
+	lifetimes = enabled;
+	lifetimeReset = true;
+	emitAccumulator = 0.0f;
+	interpolationValid = false;
+	printf("Particle lifetimes: %s\n", lifetimes ? "on (emitted at the cursor, GPU attractor mode only, no collisions)" : "off");
+	// Dead particles still have their last state, start over with all of them
+	if (!lifetimes)
+	{
+		resetBuffers();
+	}
+}
+
+bool glRenderer::stepLifetimes(float deltaT, uint32_t substeps, float destPosX, float destPosY)
+{
+	ShaderProgram &simulate = getSimulationProgram(workgroupSize, true);
+	ShaderProgram &draw = getLifetimeDrawProgram();
+	ShaderProgram* passes[5];
+	bool linked = simulate.isLinked() && draw.isLinked();
+	for (int i = 0; i < 5; i++)
+	{
+		passes[i] = &getEmitProgram(i);
+		linked &= passes[i]->isLinked();
+	}
+	if (!linked)
+	{
+		return false;
+	}
+
+	// Index lists grow with the particle buffers, all particles start dead again
+	if (lifetimeCapacity < particleCapacity)
+	{
+		particleLifetimes = growBuffer(stateCache, particleLifetimes, 0, (GLsizeiptr)particleCapacity * sizeof(GLfloat));
+		deadList = growBuffer(stateCache, deadList, 0, (GLsizeiptr)particleCapacity * sizeof(GLuint));
+		aliveLists[0] = growBuffer(stateCache, aliveLists[0], 0, (GLsizeiptr)particleCapacity * sizeof(GLuint));
+		aliveLists[1] = growBuffer(stateCache, aliveLists[1], 0, (GLsizeiptr)particleCapacity * sizeof(GLuint));
+		if (particleCounters == 0)
+		{
+			particleCounters = growBuffer(stateCache, 0, 0, LIFETIME_COUNTERS_SIZE);
+		}
+		lifetimeCapacity = particleCapacity;
+		lifetimeReset = true;
+	}
+
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, particleLifetimes);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, deadList);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, aliveLists[0]);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, aliveLists[1]);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, particleCounters);
+
+	GLuint singleGroup = 1;
+	if (lifetimeReset)
+	{
+		lifetimeReset = false;
+		emitAccumulator = 0.0f;
+		stateCache.useProgram(passes[0]->program);
+		passes[0]->setUInt("particleCount", (GLuint)particleCount);
+		dispatchParticles((GLuint)particleCount, EMIT_WORKGROUP_SIZE);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	}
+
+	// No step this frame, the last one is drawn again
+	if (substeps == 0)
+	{
+		return true;
+	}
+
+	// Emit at the rate that keeps the pool busy: on average particles live for three quarters of the maximum lifetime
+	emitAccumulator = std::min(emitAccumulator + (float)particleCount * deltaT * (float)substeps / (0.75f * particleLifetime), (float)particleCount);
+	GLuint requested = (GLuint)emitAccumulator;
+	emitAccumulator -= (float)requested;
+
+	// The emitter dispatch is sized by the GPU, only as many particles as are dead can be spawned
+	stateCache.useProgram(passes[1]->program);
+	passes[1]->setUInt("requestedCount", requested);
+	passes[1]->setUInt("maxWorkGroupCountX", maxWorkGroupCountX);
+	glDispatchCompute(singleGroup, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	stateCache.bindBuffer(GL_DISPATCH_INDIRECT_BUFFER, particleCounters);
+	stateCache.useProgram(passes[2]->program);
+	passes[2]->setVec2("emitterPos", destPosX, destPosY);
+	passes[2]->setUInt("seed", emitSeed++);
+	passes[2]->setFloat("lifetime", particleLifetime);
+	glDispatchComputeIndirect(LIFETIME_EMIT_ARGS_OFFSET);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	stateCache.useProgram(passes[3]->program);
+	passes[3]->setUInt("simulationWorkgroupSize", workgroupSize);
+	passes[3]->setUInt("maxWorkGroupCountX", maxWorkGroupCountX);
+	glDispatchCompute(singleGroup, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	// Ages, kills and moves the live particles only
+	stateCache.useProgram(simulate.program);
+	setSimulationUniforms(simulate, deltaT, destPosX, destPosY, substeps);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, SSBOPrevPos);
+	glDispatchComputeIndirect(LIFETIME_SIMULATE_ARGS_OFFSET);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	stateCache.useProgram(passes[4]->program);
+	glDispatchCompute(singleGroup, 1, 1);
+	stateCache.useProgram(0);
+	// The draw reads the alive list in the vertex shader and its count from the indirect buffer
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	std::swap(aliveLists[0], aliveLists[1]);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, aliveLists[0]);
+	stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, aliveLists[1]);
+	return true;
+}
+
+void glRenderer::resizeBuffers(int count)
+{
+	double resizeStart = glfwGetTime();
+	int previousCount = particleCount;
+	int maxCount = getMaxParticleCount();
+	if (count > maxCount)
+	{
+		printf("Particle count %d exceeds the limit of %d for the current storage layout\n", count, maxCount);
+		count = maxCount;
+	}
+	// GPU buffers also grow while simulating on the CPU, so the state can be uploaded when switching back
+	if (computeSupported && (count > particleCapacity))
+	{
+		// Grow geometrically, so ramping up the particle count only reallocates a few times
+		int capacity = std::min(std::max(count, particleCapacity * 2), maxCount);
+		// Make sure the compute shader's writes are visible to the copy
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		const ParticleLayout &layout = particleLayouts[particleLayout];
+		GLsizeiptr copySize = (GLsizeiptr)previousCount * (layout.positionSize + layout.velocitySize);
+		SSBOPos = growBuffer(stateCache, SSBOPos, (GLsizeiptr)previousCount * layout.positionSize, (GLsizeiptr)capacity * layout.positionSize);
+		stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBOPos);
+		// Interleaved layouts store everything in the first buffer
+		if (layout.velocitySize > 0)
+		{
+			SSBOVel = growBuffer(stateCache, SSBOVel, (GLsizeiptr)previousCount * layout.velocitySize, (GLsizeiptr)capacity * layout.velocitySize);
+			stateCache.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, SSBOVel);
+		}
+		// Only written and read within a frame, so there's nothing to keep
+		SSBOPrevPos = growBuffer(stateCache, SSBOPrevPos, 0, (GLsizeiptr)capacity * 2 * sizeof(GLfloat));
+		printf("Particle capacity: %d -> %d (%.2f MB copied)\n", particleCapacity, capacity, (double)copySize / (1024.0 * 1024.0));
+		particleCapacity = capacity;
+	}
+
+	// Only particles that were added are seeded, shrinking keeps the capacity
+	particleCount = count;
+	// The lifetime pool starts over with the new size, new particles have no previous position
+	lifetimeReset = true;
+	interpolationValid = false;
+	if (cpuSimulation)
+	{
+		cpuParticles.resize((uint32_t)count);
+	}
+	if (count > previousCount)
+	{
+		if (cpuSimulation)
+		{
+			seedCpuParticles(previousCount, count - previousCount);
+		}
+		else
+		{
+			seedParticles(previousCount, count - previousCount);
+		}
+	}
+	printf("particle count : %d (%.2f ms)\n", particleCount, (glfwGetTime() - resizeStart) * 1000.0);
 }
 
 void glRenderer::generateBuffers()
@@ -261,34 +1189,26 @@ void glRenderer::generateBuffers()
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 
-	// Position SSBO
-	if (glIsBuffer(SSBOPos)) {
-		glDeleteBuffers(1, &SSBOPos);
-	};
-	glGenBuffers(1, &SSBOPos);
-	// Bind to SSBO
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBOPos);
-	// Generate empty storage for the SSBO
-	glBufferData(GL_SHADER_STORAGE_BUFFER, particleCount * sizeof(vertex4f), NULL, GL_STATIC_DRAW);
-	// Fill
-	resetPositionSSBO();
-	// Bind buffer to target index 0
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBOPos);
-
-	// Velocity SSBO
-	if (glIsBuffer(SSBOVel)) {
-		glDeleteBuffers(1, &SSBOVel);
-	};
-	glGenBuffers(1, &SSBOVel);
-	// Bind to SSBO
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBOVel);
-	// Generate empty storage for the SSBO
-	glBufferData(GL_SHADER_STORAGE_BUFFER, particleCount * sizeof(vertex4f), NULL, GL_STATIC_DRAW);
-	// Fill
-	resetVelocitySSBO();
-	// Bind buffer to target index 1
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, SSBOVel);
+	// Without compute shaders (OpenGL 4.3) the particles are simulated on the CPU
+	computeSupported = (GLEW_VERSION_4_3 || GLEW_ARB_compute_shader) && GLEW_ARB_shader_storage_buffer_object;
+	if (!computeSupported)
+	{
+		cpuSimulation = true;
+		printf("Compute shaders not supported, simulating on the CPU (%s, %u threads)\n", CpuParticleSystem::getSimdLevelName(cpuParticles.simdLevel), threadPool.getThreadCount());
+	}
+	else
+	{
+		GLint maxGroups = 0;
+		glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxGroups);
+		maxWorkGroupCountX = (GLuint)maxGroups;
+		glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxStorageBlockSize);
+		printf("Max. workgroups in x: %u, max. shader storage block size: %.1f MB (%d particles)\n", maxWorkGroupCountX, (double)maxStorageBlockSize / (1024.0 * 1024.0), getMaxParticleCount());
+	}
 
+	// Position (target index 0) and velocity (target index 1) SSBOs, created with the initial particle count as capacity
+	int count = particleCount;
+	particleCount = 0;
+	resizeBuffers(count);
 }
 
 void glRenderer::generateTextures()
@@ -298,6 +1218,10 @@ void glRenderer::generateTextures()
 
 void glRenderer::renderScene()
 {
+	// Measured from frame to frame, long stalls (compiling, tuning) are clamped instead of being simulated
+	double frameTime = glfwGetTime();
+	frameDelta = (lastFrameTime > 0.0) ? (float)std::min(frameTime - lastFrameTime, 0.25) * 100.0f : 0.0f;
+	lastFrameTime = frameTime;
 
 	if (colorFade)
 	{
@@ -340,14 +1264,40 @@ void glRenderer::renderScene()
 	}
 
 
-	double frameTimeStart = glfwGetTime();
-
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	// Nothing to simulate or draw until both programs have been compiled
+	compileManager.poll();
+	shaderSources.update(compileManager);
+	if (!baseshader.isLinked() || (!cpuSimulation && !simulation->isLinked()))
+	{
+		glfwSwapBuffers(window);
+		return;
+	}
+
+	if (autoTune)
+	{
+		autoTune = false;
+		autoTuneWorkgroupSize();
+	}
+
+	if (benchmarkLayout)
+	{
+		benchmarkLayout = false;
+		benchmarkLayouts();
+	}
+
+	if (verifyGpu)
+	{
+		verifyGpu = false;
+		verifyGpuSimulation();
+	}
+
+	// State changes go through the state cache, which filters redundant calls
+	stateCache.enable(GL_BLEND);
+	stateCache.blendFunc(GL_SRC_ALPHA, GL_ONE);
 
-	// Run compute shader
+	// Run simulation
 
 	double cursorX, cursorY;
 	int windowWidth, windowHeight;
@@ -357,42 +1307,145 @@ void glRenderer::renderScene()
 	float destPosX = (float)(cursorX / (windowWidth) - 0.5f) * 2.0f;
 	float destPosY = (float)((windowHeight - cursorY) / windowHeight - 0.5f) * 2.0f;
 
-	glUseProgram(computeshader);
-	glUniform1f(glGetUniformLocation(computeshader, "deltaT"), frameDelta * speedMultiplier * (pause ? 0.0f : 1.0f));
-	glUniform3f(glGetUniformLocation(computeshader, "destPos"), destPosX, destPosY, 0);
-	glUniform2f(glGetUniformLocation(computeshader, "vpDim"), 1, 1);
-	glUniform1i(glGetUniformLocation(computeshader, "borderClamp"), (int)borderEnabled);
+	float deltaT = frameDelta * speedMultiplier * (pause ? 0.0f : 1.0f);
 
-	int workingGroups = particleCount / 16;
+	// Fixed timestep: the frame's time is simulated in a whole number of equal steps, the remainder is carried over
+	// and used to draw the particles in between the last two steps
+	uint32_t substeps = 1;
+	float interpolation = 1.0f;
+	if (fixedTimestep)
+	{
+		// Fixed steps can't run backwards, a negative speed holds the simulation instead
+		// (the accumulator is never negative, so it can be converted to a step count)
+		stepAccumulator += std::max(deltaT, 0.0f);
+		substeps = (uint32_t)(stepAccumulator / SIMULATION_STEP);
+		// Time that can't be caught up with is dropped, instead of taking longer and longer frames
+		if (substeps > MAX_SUBSTEPS)
+		{
+			substeps = MAX_SUBSTEPS;
+			stepAccumulator = SIMULATION_STEP * MAX_SUBSTEPS;
+		}
+		stepAccumulator -= SIMULATION_STEP * substeps;
+		interpolation = stepAccumulator / SIMULATION_STEP;
+		deltaT = SIMULATION_STEP;
+	}
+	// Previous positions are only written by the GPU attractor simulation
+	bool interpolate = false;
+
+	// Interleaved layouts skip the velocity between positions
+	const ParticleLayout &layout = particleLayouts[particleLayout];
+	GLuint vertexBuffer = SSBOPos;
+	GLintptr vertexOffset = 0;
+	int positionComponents = layout.positionComponents;
+	int vertexStride = layout.vertexStride;
+	// Live particles are drawn with a vertex count written by the GPU
+	bool drawLifetimes = false;
+
+	if (cpuSimulation)
+	{
+		// Writes tightly packed xy positions to a vertex buffer
+		vertexBuffer = updateCpuSimulation(deltaT, substeps, destPosX, destPosY, vertexOffset);
+		positionComponents = 2;
+		vertexStride = 0;
+		interpolationValid = false;
+	}
+	else if (simulationMode != SIMULATION_ATTRACTOR)
+	{
+		// Back-to-back dispatches, the force pass of each step reads all positions of the last one
+		for (uint32_t i = 0; i < substeps; i++)
+		{
+			stepNBody(deltaT);
+		}
+		interpolationValid = false;
+	}
+	else if (lifetimes && stepLifetimes(deltaT, substeps, destPosX, destPosY))
+	{
+		drawLifetimes = true;
+		interpolationValid |= (substeps > 0);
+		interpolate = interpolationValid;
+	}
+	else
+	{
+		// All substeps are taken in a single dispatch, looping in the shader
+		if (substeps > 0)
+		{
+			// Neighbor forces only change velocities, the simulation moves the particles afterwards
+			if (collisions)
+			{
+				collideParticles(deltaT * (float)substeps);
+			}
 
-	glDispatchCompute(workingGroups, 1, 1);
+			// Uniform locations are reflected once after linking, unchanged values are not passed on to GL
+			stateCache.useProgram(simulation->program);
+			setSimulationUniforms(*simulation, deltaT, destPosX, destPosY, substeps);
 
-	glUseProgram(0);
+			dispatchSimulation(workgroupSize);
 
-	// Set memory barrier on per vertex base to make sure we get what was written by the compute shaders
-	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+			stateCache.useProgram(0);
+
+			// Set memory barrier on per vertex base to make sure we get what was written by the compute shaders
+			glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+			interpolationValid = true;
+		}
+		interpolate = interpolationValid;
+	}
+	if (!interpolate)
+	{
+		interpolation = 1.0f;
+	}
 
 	// Render scene
 
-	glUseProgram(baseshader);
+	ShaderProgram &drawProgram = drawLifetimes ? getLifetimeDrawProgram() : baseshader;
+	stateCache.useProgram(drawProgram.program);
 
-	glUniform4f(glGetUniformLocation(baseshader, "inColor"), color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f, 1.0f);
+	drawProgram.setVec4("inColor", color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f, 1.0f);
+	drawProgram.setFloat("interpolation", interpolation);
 
 	glGetError();
 
-	glBindTexture(GL_TEXTURE_2D, particleTex);
+	stateCache.activeTexture(GL_TEXTURE0);
+	stateCache.bindTexture(GL_TEXTURE_2D, particleTex);
 
-	GLuint posAttrib = glGetAttribLocation(baseshader, "pos");
-
-	glBindBuffer(GL_ARRAY_BUFFER, SSBOPos);
-	glVertexAttribPointer(posAttrib, 4, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(posAttrib);
 	glPointSize(16);
-	glDrawArrays(GL_POINTS, 0, particleCount);
+	if (drawLifetimes)
+	{
+		// Positions are fetched through the alive list, no vertex attributes
+		stateCache.bindBuffer(GL_DRAW_INDIRECT_BUFFER, particleCounters);
+		glDrawArraysIndirect(GL_POINTS, (const GLvoid*)LIFETIME_DRAW_ARGS_OFFSET);
+	}
+	else
+	{
+		GLuint posAttrib = baseshader.getAttribLocation("pos");
+		GLuint prevPosAttrib = baseshader.getAttribLocation("prevPos");
+
+		stateCache.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glVertexAttribPointer(posAttrib, positionComponents, GL_FLOAT, GL_FALSE, vertexStride, (const GLvoid*)vertexOffset);
+		stateCache.enableVertexAttribArray(posAttrib);
+		// Without interpolation the previous position is the current one
+		if (interpolate)
+		{
+			stateCache.bindBuffer(GL_ARRAY_BUFFER, SSBOPrevPos);
+			glVertexAttribPointer(prevPosAttrib, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
+		}
+		else
+		{
+			GLsizei positionStride = (vertexStride != 0) ? vertexStride : positionComponents * sizeof(GLfloat);
+			glVertexAttribPointer(prevPosAttrib, 2, GL_FLOAT, GL_FALSE, positionStride, (const GLvoid*)vertexOffset);
+		}
+		stateCache.enableVertexAttribArray(prevPosAttrib);
+		glDrawArrays(GL_POINTS, 0, particleCount);
+	}
+
+	// Fences the region written this frame, so the CPU doesn't overwrite it while it's drawn
+	if (cpuSimulation && cpuVertexStream.isCreated())
+	{
+		cpuVertexStream.nextFrame();
+	}
 
 	glfwSwapBuffers(window);
 
-	frameDelta = (float)(glfwGetTime() - frameTimeStart) * 100.0f;
+	stateCache.endFrame();
 
 }
 
@@ -410,16 +1463,48 @@ void glRenderer::keyCallback(int key, int scancode, int action, int mods)
 		colorFade = !colorFade;
 	if (key == GLFW_KEY_P && action == GLFW_PRESS)
 		pause = !pause;
-	if (key == GLFW_KEY_PAGE_UP && action == GLFW_PRESS)
+	if (key == GLFW_KEY_S && action == GLFW_PRESS)
+		printStateReport = !printStateReport;
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+		setCpuSimulation(!cpuSimulation);
+	// Compute shader functions
+	if (key == GLFW_KEY_T && action == GLFW_PRESS && computeSupported)
+		autoTune = true;
+	if (key == GLFW_KEY_L && action == GLFW_PRESS && computeSupported)
+		setParticleLayout((particleLayout + 1) % PARTICLE_LAYOUT_COUNT);
+	if (key == GLFW_KEY_M && action == GLFW_PRESS && computeSupported)
+		benchmarkLayout = true;
+	if (key == GLFW_KEY_V && action == GLFW_PRESS && computeSupported)
+		verifyGpu = true;
+	if (key == GLFW_KEY_H && action == GLFW_PRESS && computeSupported)
 	{
-		particleCount += 1024;
-		printf("particle count : %d\nRegenerating SSBOs...\n", particleCount);
-		generateBuffers();
+		collisions = !collisions;
+		printf("Particle collisions (spatial hash, sorted by cell every frame): %s\n", collisions ? "on" : "off");
 	}
-	if (key == GLFW_KEY_PAGE_DOWN && action == GLFW_PRESS && particleCount > 1024)
+	if (key == GLFW_KEY_F && action == GLFW_PRESS)
+	{
+		fixedTimestep = !fixedTimestep;
+		stepAccumulator = 0.0f;
+		printf("Fixed timestep: %s\n", fixedTimestep ? "on" : "off (one step of the frame time per frame)");
+	}
+	if (key == GLFW_KEY_E && action == GLFW_PRESS && computeSupported)
+		setLifetimes(!lifetimes);
+	if (key == GLFW_KEY_N && action == GLFW_PRESS && computeSupported)
+		setSimulationMode((simulationMode + 1) % SIMULATION_MODE_COUNT);
+	if (key == GLFW_KEY_K && action == GLFW_PRESS && computeSupported)
 	{
-		particleCount -= 1024;
-		printf("particle count : %d\nRegenerating SSBOs...\n", particleCount);
-		generateBuffers();
+		// Next power of two the GPU supports as workgroup size
+		std::vector<uint32_t> sizes = WorkgroupSizeTuner::getCandidates(64);
+		auto next = std::upper_bound(sizes.begin(), sizes.end(), nbodyTileSize);
+		setNBodyTileSize((next != sizes.end()) ? *next : sizes.front());
 	}
+	// Resizing keeps the state of existing particles
+	if (key == GLFW_KEY_PAGE_UP && action == GLFW_PRESS)
+		resizeBuffers(particleCount + 1024);
+	if (key == GLFW_KEY_PAGE_DOWN && action == GLFW_PRESS && particleCount > 1024)
+		resizeBuffers(particleCount - 1024);
+	if (key == GLFW_KEY_KP_MULTIPLY && action == GLFW_PRESS && particleCount <= MAX_PARTICLE_COUNT / 2)
+		resizeBuffers(particleCount * 2);
+	if (key == GLFW_KEY_KP_DIVIDE && action == GLFW_PRESS && particleCount > 1024)
+		resizeBuffers(particleCount / 2);
 }
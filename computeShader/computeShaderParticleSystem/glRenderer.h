@@ -11,37 +11,226 @@ to move the particles towards the target position
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "../../base/glStateCache.hpp"
+#include "../../base/shaderProgram.hpp"
+#include "../../base/programCache.hpp"
+#include "../../base/shaderCompileManager.hpp"
+#include "../../base/spirvShader.hpp"
+#include "../../base/workgroupTuner.hpp"
+#include "../../base/streamingBuffer.hpp"
+#include "cpuParticleSystem.hpp"
+
+#include <map>
+#include <vector>
+
+// Workgroup size used until the simulation has been tuned on the current GPU and driver
+#define DEFAULT_WORKGROUP_SIZE 256
+// Workgroup size of the particle reset shader
+#define RESET_WORKGROUP_SIZE 256
+
+// Fixed simulation step in deltaT units (a 60 fps frame at the default speed) and the most steps taken per frame
+#define SIMULATION_STEP 0.25f
+#define MAX_SUBSTEPS 8
+
+// Upper limit for doubling the particle count (two vec4 buffers of this size use 16 GB)
+// Each particle buffer also has to fit into GL_MAX_SHADER_STORAGE_BLOCK_SIZE, see getMaxParticleCount()
+#define MAX_PARTICLE_COUNT (512 * 1024 * 1024)
+
+// Particle storage layouts, must match PARTICLE_LAYOUT in data/shader/particle_buffers.glsl
+#define PARTICLE_LAYOUT_VEC4 0
+#define PARTICLE_LAYOUT_PACKED 1
+#define PARTICLE_LAYOUT_HALF_VELOCITY 2
+#define PARTICLE_LAYOUT_AOS 3
+#define PARTICLE_LAYOUT_COUNT 4
+
+// Simulation modes of the GPU
+#define SIMULATION_ATTRACTOR 0
+#define SIMULATION_NBODY 1
+#define SIMULATION_NBODY_GRID 2
+#define SIMULATION_MODE_COUNT 3
+
+// N-body: tile size (= workgroup size) of the force pass, grid resolution of the approximation
+#define NBODY_DEFAULT_TILE_SIZE 256
+#define NBODY_GRID_SIZE 64
+// Workgroup size of the binning and integration passes
+#define NBODY_WORKGROUP_SIZE 256
+// Floating point operations per interaction, as counted by GPU Gems 3 (chapter 31) for comparison
+#define NBODY_FLOPS_PER_INTERACTION 20
+
+// Spatial hashing for neighbor queries, see data/shader/spatial_hash.glsl
+#define SPATIAL_HASH_BITS 16
+#define SPATIAL_CELL_SIZE 0.01f
+// Radix sort of the cell keys, 4 bits per pass
+#define SORT_WORKGROUP_SIZE 256
+#define RADIX_BITS 4
+
+// Particle lifetimes: byte offsets in the counter buffer, must match data/shader/particle_lifetime.glsl
+#define LIFETIME_EMIT_ARGS_OFFSET 0
+#define LIFETIME_SIMULATE_ARGS_OFFSET 12
+#define LIFETIME_DRAW_ARGS_OFFSET 24
+#define LIFETIME_COUNTERS_SIZE 56
+#define EMIT_WORKGROUP_SIZE 256
+
+struct ParticleLayout
+{
+	const char *name;
+	// Bytes per particle in the position and velocity buffer (velocity is 0 if it's interleaved with the position)
+	int positionSize;
+	int velocitySize;
+	// Position attribute as read by the vertex shader
+	int positionComponents;
+	int vertexStride;
+};
+
 class glRenderer
 {
 private:
-	GLuint baseshader;
-	GLuint computeshader;
-	GLuint SSBOPos;
-	GLuint SSBOVel;
+	ShaderProgram baseshader;
+	// Settings (cache, uniform aliases) shared by all simulation variants
+	ShaderProgram computeshader;
+	// Variant of the simulation for the current workgroup size
+	ShaderProgram *simulation = nullptr;
+	std::vector<uint32_t> simulationSpirv;
+	std::map<uint32_t, ShaderProgram> spirvSimulations;
+	WorkgroupSizeTuner workgroupTuner;
+	// Seeds particles with a counter based RNG
+	ShaderProgram resetShader;
+	// Variant of the reset shader for the current storage layout
+	ShaderProgram *resetProgram = nullptr;
+	uint32_t resetSeed = 1;
+	ProgramCache programCache;
+	ShaderCompileManager compileManager;
+	GLuint SSBOPos = 0;
+	GLuint SSBOVel = 0;
+	// Number of particles the SSBOs can hold, grows geometrically
+	int particleCapacity = 0;
+	// Limits of the implementation, dispatches with more workgroups than fit into x are split over x and y
+	GLuint maxWorkGroupCountX = 65535;
+	GLint64 maxStorageBlockSize = 0;
 	GLuint particleTex;
+	// Wall clock time between the last two frames, in 1/100 s
 	float frameDelta = 0.0f;
+	double lastFrameTime = 0.0;
+	// Frame time is accumulated and simulated in steps of SIMULATION_STEP, so the result doesn't depend on the frame rate
+	bool fixedTimestep = true;
+	float stepAccumulator = 0.0f;
+	// Positions before the last step of the GPU simulation, particles are drawn interpolated towards the current ones
+	GLuint SSBOPrevPos = 0;
+	bool interpolationValid = false;
 	float speedMultiplier = 0.15f;
 	bool borderEnabled = true;
 	bool colorFade = false;
 	bool pause = false;
+	// Specialization constants of the simulation shader (defines for the GLSL fallback)
+	uint32_t workgroupSize = DEFAULT_WORKGROUP_SIZE;
+	bool applyGravity = false;
+	bool autoTune = false;
+	int particleLayout = PARTICLE_LAYOUT_VEC4;
+	bool benchmarkLayout = false;
+	// CPU simulation, used if compute shaders are not supported and as a reference for the GPU results
+	CpuParticleSystem cpuParticles;
+	bool computeSupported = true;
+	bool cpuSimulation = false;
+	bool verifyGpu = false;
+	// Positions written by the CPU simulation, persistently mapped if buffer storage is supported
+	StreamingBuffer cpuVertexStream;
+	GLsizeiptr cpuVertexStreamSize = 0;
+	GLuint cpuVertexBuffer = 0;
+	std::vector<float> cpuVertices;
+	// N-body modes, GPU only
+	ShaderProgram nbodyShader;
+	int simulationMode = SIMULATION_ATTRACTOR;
+	uint32_t nbodyTileSize = NBODY_DEFAULT_TILE_SIZE;
+	float nbodyGravity = 0.0002f;
+	float nbodySoftening = 0.05f;
+	GLuint nbodyGrid = 0;
+	// Step times are measured with two timer queries that are read back two frames later, so they never stall
+	GLuint nbodyQueries[2];
+	double nbodyQueryInteractions[2];
+	uint32_t nbodyFrame = 0;
+	double nbodyTime = 0.0;
+	double nbodyInteractions = 0.0;
+	uint32_t nbodySteps = 0;
+	double nbodyReportTime = 0.0;
+	// Spatial hash for neighbor queries, particles are sorted by cell every frame while collisions are enabled
+	ShaderProgram spatialShader;
+	bool collisions = false;
+	float collisionStiffness = 0.001f;
+	// Two key / value buffers to ping-pong between during the radix sort
+	GLuint sortKeys[2] = { 0, 0 };
+	GLuint sortValues[2] = { 0, 0 };
+	GLuint sortHistograms = 0;
+	int sortCapacity = 0;
+	GLuint cellStart = 0;
+	GLuint cellEnd = 0;
+	// Particles are gathered in sorted order into these, and then swapped with the current particle buffers
+	GLuint sortedPos = 0;
+	GLuint sortedVel = 0;
+	int sortedCapacity = 0;
+	// Particle lifetimes (GPU attractor mode), particles are emitted from a pool of dead particles and recycled when they expire
+	ShaderProgram emitShader;
+	ShaderProgram lifetimeDrawShader;
+	bool lifetimes = false;
+	// Marks all particles of the pool as dead before the next step
+	bool lifetimeReset = true;
+	// Maximum lifetime in simulation time (deltaT)
+	float particleLifetime = 50.0f;
+	float emitAccumulator = 0.0f;
+	uint32_t emitSeed = 1;
+	GLuint particleLifetimes = 0;
+	GLuint deadList = 0;
+	// Current and next alive list, swapped after each step
+	GLuint aliveLists[2] = { 0, 0 };
+	// Counters, indirect dispatch and draw arguments
+	GLuint particleCounters = 0;
+	int lifetimeCapacity = 0;
 	float color[3];
 	float colVec[3];
 	float colorChangeTimer;
 	float colorChangeLength;
-	void resetPositionSSBO();
-	void resetVelocitySSBO();
-	GLuint loadShader(const char* vertexShaderFile, const char* fragmentShaderFile);
-	GLuint loadComputeShader(const char* computeShaderFile);
-	void printProgramLog(GLuint shader);
-	void printShaderLog(GLuint program);
+	ShaderProgram& getSimulationProgram(uint32_t size, bool lifetime = false);
+	ShaderProgram& getResetProgram();
+	void setSimulationUniforms(ShaderProgram &program, float deltaT, float destPosX, float destPosY, uint32_t substeps = 1);
+	void dispatchParticles(GLuint count, GLuint size);
+	void dispatchSimulation(uint32_t size);
+	int getMaxParticleCount();
+	void autoTuneWorkgroupSize();
+	void setParticleLayout(int layout);
+	void benchmarkLayouts();
+	void downloadParticles(CpuParticleSystem &particles);
+	void uploadParticles(const CpuParticleSystem &particles);
+	void setCpuSimulation(bool enabled);
+	GLuint updateCpuSimulation(float deltaT, uint32_t substeps, float destPosX, float destPosY, GLintptr &vertexOffset);
+	void verifyGpuSimulation();
+	void seedCpuParticles(int first, int count);
+	ShaderProgram& getNBodyProgram(const std::string &fileName, uint32_t size, bool grid);
+	void setSimulationMode(int mode);
+	void setNBodyTileSize(uint32_t size);
+	void stepNBody(float deltaT);
+	void reportNBodyPerformance();
+	ShaderProgram& getSpatialProgram(const std::string &fileName, const std::vector<std::string> &passDefines, bool particleAccess);
+	bool sortParticles();
+	void collideParticles(float deltaT);
+	ShaderProgram& getEmitProgram(int pass);
+	ShaderProgram& getLifetimeDrawProgram();
+	void setLifetimes(bool enabled);
+	bool stepLifetimes(float deltaT, uint32_t substeps, float destPosX, float destPosY);
+	void getResetPosition(float &destPosX, float &destPosY);
+	void seedParticles(int first, int count);
+	void resetPositionSSBO(int first, int count);
+	void resetVelocitySSBO(int first, int count);
 public:
 	GLFWwindow* window;
+	// Filters redundant state changes and counts GL calls per frame
+	GLStateCache stateCache;
+	bool printStateReport = false;
 	int particleCount = 1024 * 2;
 	glRenderer();
 	~glRenderer();
 	void generateShaders();
 	void generateBuffers();
 	void resetBuffers();
+	void resizeBuffers(int count);
 	void generateTextures();
 	void renderScene();
 	void keyCallback(int key, int scancode, int action, int mods);
@@ -15,6 +15,7 @@ to move the particles towards the target position
 //Include the standard C++ headers
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <Windows.h>
 #include <string>
 
@@ -100,8 +101,18 @@ static void APIENTRY glDebugCallback(GLenum source, GLenum type, GLuint id, GLen
 	printf("glDebugMessage:\n%s \n type = %s source = %s severity = %s\n", message, msgType.c_str(), msgSource.c_str(), msgSeverity.c_str());
 }
 
-int main(void)
+int main(int argc, char *argv[])
 {
+	// Headless regression test of the CPU simulation, doesn't need a window or GL context
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--cpu-selftest") == 0)
+		{
+			ThreadPool threadPool;
+			return CpuParticleSystem::selfTest(threadPool) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
 	//Set the error callback
 	glfwSetErrorCallback(error_callback);
 
@@ -125,6 +136,13 @@ int main(void)
 //	window = glfwCreateWindow(1920, 1200, "OpenGL Compute Shader Particle System", glfwGetPrimaryMonitor(), NULL);
 	window = glfwCreateWindow(1280, 720, "OpenGL Compute Shader Particle System", NULL, NULL);
 
+	// Drivers without OpenGL 4.3 get a 4.1 context, particles are then simulated on the CPU
+	if (!window)
+	{
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+		window = glfwCreateWindow(1280, 720, "OpenGL Compute Shader Particle System", NULL, NULL);
+	}
+
 	//If the window couldn't be created
 	if (!window)
 	{
@@ -179,10 +197,23 @@ int main(void)
 	printf("""p"" : Toggle pause\n");
 	printf("""b"" : toggle viewport border for particle movement\n");
 	printf("""c"" : toggle random color fade\n");
+	printf("""s"" : toggle per frame GL state call report\n");
+	printf("""t"" : find the fastest compute workgroup size for this GPU\n");
+	printf("""l"" : cycle particle storage layouts\n");
+	printf("""m"" : benchmark all particle storage layouts\n");
+	printf("""g"" : toggle simulation on the CPU\n");
+	printf("""v"" : verify the GPU simulation against the CPU reference\n");
+	printf("""n"" : cycle simulation modes (attractor, N-body, approximated N-body)\n");
+	printf("""k"" : cycle N-body tile sizes\n");
+	printf("""h"" : toggle particle collisions (spatial hash neighbor search)\n");
+	printf("""e"" : toggle particle lifetimes (emitter with GPU dead list)\n");
+	printf("""f"" : toggle fixed simulation timestep\n");
 	printf("""+"" : increase speed\n");
 	printf("""-"" : decrease speed\n");
 	printf("""page up"" : increase particle count by 1024\n");
 	printf("""page down"" : decrease particle count by 1024\n");
+	printf("""numpad *"" : double particle count\n");
+	printf("""numpad /"" : halve particle count\n");
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -209,6 +240,11 @@ int main(void)
 			const char* windowCaption = windowTitle.c_str();
 			glfwSetWindowTitle(window, windowCaption);
 
+			if (renderer.printStateReport)
+			{
+				renderer.stateCache.printReport();
+			}
+
 			frameCounter = 0;
 		}
 
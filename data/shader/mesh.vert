@@ -3,6 +3,20 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
+// SPIR-V version (glslangValidator -G -o mesh.vert.spv mesh.vert) specializes the instance array bound
+// and the color source at load time, the GLSL version uses the defaults below
+#ifdef GL_SPIRV
+layout (constant_id = 0) const int INSTANCE_COUNT = 343;
+layout (constant_id = 1) const bool USE_INSTANCE_COLOR = true;
+#else
+#ifndef INSTANCE_COUNT
+#define INSTANCE_COUNT 343
+#endif
+#ifndef USE_INSTANCE_COLOR
+#define USE_INSTANCE_COLOR true
+#endif
+#endif
+
 layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 3) in vec3 inColor;
@@ -21,7 +35,7 @@ layout (binding = 0) uniform UBO
 
 layout (binding = 1) uniform UBOInst
 {
-	Instance instance[343];
+	Instance instance[INSTANCE_COUNT];
 } uboinstance;
 
 layout (location = 0) out vec3 outNormal;
@@ -32,8 +46,7 @@ layout (location = 3) out vec3 outLightVec;
 void main() 
 {
 	outNormal = inNormal;
-	outColor = inColor;
-	outColor = uboinstance.instance[gl_InstanceID].color.rgb;
+	outColor = USE_INSTANCE_COLOR ? uboinstance.instance[gl_InstanceID].color.rgb : inColor;
 	mat4 modelView = ubo.view * uboinstance.instance[gl_InstanceID].model;	
 	gl_Position = ubo.projection * modelView * vec4(inPos.xyz, 1.0);
 	outEyePos = (gl_Position).xyz;
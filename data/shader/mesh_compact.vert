@@ -0,0 +1,61 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+
+// 32 bytes per instance
+struct Instance
+{
+	// xyz = translation, w = uniform scale
+	vec4 positionScale;
+	// x = quaternion xy (snorm16), y = quaternion zw (snorm16), z = RGBA8 color, w = unused
+	uvec4 rotationColor;
+};
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 viewProjection;
+} ubo;
+
+layout (std430, binding = 1) readonly buffer InstanceBuffer
+{
+	Instance instances[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outEyePos;
+layout (location = 3) out vec3 outLightVec;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() 
+{
+	Instance instance = instances[gl_InstanceID];
+
+	vec4 q = normalize(vec4(unpackSnorm2x16(instance.rotationColor.x), unpackSnorm2x16(instance.rotationColor.y)));
+
+	// Model matrix = translation * rotation * scale, rebuilt from the decoded instance data
+	float scale = instance.positionScale.w;
+	mat4 model = mat4(
+		vec4(rotate(q, vec3(scale, 0.0, 0.0)), 0.0),
+		vec4(rotate(q, vec3(0.0, scale, 0.0)), 0.0),
+		vec4(rotate(q, vec3(0.0, 0.0, scale)), 0.0),
+		vec4(instance.positionScale.xyz, 1.0));
+
+	outNormal = inNormal;
+	outColor = unpackUnorm4x8(instance.rotationColor.z).rgb;
+	mat4 modelView = ubo.view * model;
+	gl_Position = ubo.projection * modelView * vec4(inPos.xyz, 1.0);
+	outEyePos = (gl_Position).xyz;
+	vec4 lightPos = vec4(0.0, 0.0, 0.0, 1.0) * modelView;
+	outLightVec = normalize(lightPos.xyz - outEyePos);
+}
@@ -0,0 +1,67 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+
+layout (binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 view;
+} ubo;
+
+// Grid parameters, no per instance data is stored anywhere
+layout (binding = 2) uniform UBOProcedural
+{
+	// xyz = grid range per axis
+	ivec4 range;
+	// xyz = distance between instances, w = rotation around y axis
+	vec4 spacing;
+	// x = seed for the color hash
+	uvec4 seed;
+} grid;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outEyePos;
+layout (location = 3) out vec3 outLightVec;
+
+// Integer hash (lowbias32) for stable per instance colors
+uint hash(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+void main()
+{
+	// Grid position from instance index, z runs fastest (same order as the cpu side loops)
+	ivec3 dim = grid.range.xyz * 2 + 1;
+	int id = gl_InstanceID;
+	ivec3 cell = ivec3(id / (dim.y * dim.z), (id / dim.z) % dim.y, id % dim.z) - grid.range.xyz;
+
+	// Model matrix = translation * rotation around y axis
+	float s = sin(grid.spacing.w);
+	float c = cos(grid.spacing.w);
+	mat4 model = mat4(
+		c,    0.0, -s,   0.0,
+		0.0,  1.0, 0.0,  0.0,
+		s,    0.0, c,    0.0,
+		vec3(cell) * grid.spacing.xyz, 1.0);
+
+	uint h = hash(uint(gl_InstanceID) ^ grid.seed.x);
+	outColor = vec3(h & 0xFFU, (h >> 8) & 0xFFU, (h >> 16) & 0xFFU) / 255.0;
+
+	outNormal = inNormal;
+	mat4 modelView = ubo.view * model;
+	gl_Position = ubo.projection * modelView * vec4(inPos.xyz, 1.0);
+	outEyePos = (gl_Position).xyz;
+	vec4 lightPos = vec4(0.0, 0.0, 0.0, 1.0) * modelView;
+	outLightVec = normalize(lightPos.xyz - outEyePos);
+}
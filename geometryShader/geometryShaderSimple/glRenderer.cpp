@@ -18,25 +18,12 @@ This code is licensed under the Mozilla Public License Version 2.0 (http://opens
 #include <algorithm>
 
 #include "glRenderer.h"
+#include "../../base/shaderSourceManager.hpp"
 
 using namespace std;
 
-string readFile(const char *fileName) 
-{
-	string fileContent;
-	ifstream fileStream(fileName, ios::in);
-	if (!fileStream.is_open()) {
-		printf("File %s not found\n", fileName);
-		return "";
-	}
-	string line = "";
-	while (!fileStream.eof()) {
-		getline(fileStream, line);
-		fileContent.append(line + "\n");
-	}
-	fileStream.close();
-	return fileContent;
-}
+// Reads shader files (vertex and fragment shader are shared by both programs) and reloads them on change
+ShaderSourceManager shaderSources;
 
 glRenderer::glRenderer()
 {
@@ -47,100 +34,22 @@ glRenderer::~glRenderer()
 {
 }
 
-void glRenderer::printProgramLog(GLuint program)
-{
-	GLint result = GL_FALSE;
-	int logLength;
-
-	glGetProgramiv(program, GL_LINK_STATUS, &result);
-	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-	if (logLength > 0) {
-		GLchar* strInfoLog = new GLchar[logLength + 1];
-		glGetProgramInfoLog(program, logLength, NULL, strInfoLog);
-		printf("programlog: %s\n", strInfoLog);
-	};
-}
-
-void glRenderer::printShaderLog(GLuint shader)
-{
-	GLint result = GL_FALSE;
-	int logLength;
-
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
-	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-	if (logLength > 0) {
-		GLchar* strInfoLog = new GLchar[logLength + 1];
-		glGetShaderInfoLog(shader, logLength, NULL, strInfoLog);
-		printf("shaderlog: %s\n", strInfoLog);
-	};
-}
-
-
-GLuint glRenderer::loadShader(const char* vertexShaderFile, const char* fragmentShaderFile, const char* geometryShader)
-{
-	GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-	GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read shaders
-	std::string vertShaderStr = readFile(vertexShaderFile);
-	std::string fragShaderStr = readFile(fragmentShaderFile);
-	const char *vertShaderSrc = vertShaderStr.c_str();
-	const char *fragShaderSrc = fragShaderStr.c_str();
-	GLint result = GL_FALSE;
-
-	// Compile vertex shader
-	std::cout << "Compiling vertex shader." << std::endl;
-	glShaderSource(vertShader, 1, &vertShaderSrc, NULL);
-	glCompileShader(vertShader);
-	printShaderLog(vertShader);
-
-	// Compile fragment shader
-	std::cout << "Compiling fragment shader." << std::endl;
-	glShaderSource(fragShader, 1, &fragShaderSrc, NULL);
-	glCompileShader(fragShader);
-	printShaderLog(fragShader);
-
-	// Compile geometry shader
-	GLuint geomShader;
-	if (geometryShader != "") {
-		geomShader = glCreateShader(GL_GEOMETRY_SHADER);
-		std::string geomShaderStr = readFile(geometryShader);
-		const char *geomShaderSrc = geomShaderStr.c_str();
-		std::cout << "Compiling geometry shader." << std::endl;
-		glShaderSource(geomShader, 1, &geomShaderSrc, NULL);
-		glCompileShader(geomShader);
-		printShaderLog(geomShader);
-	}
-
-	std::cout << "Linking program" << std::endl;
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vertShader);
-	glAttachShader(program, fragShader);
-	if (geometryShader != "") {
-		glAttachShader(program, geomShader);
-	}
-
-	// Bind vertex attributes to VBO indices
-	glBindAttribLocation(program, 0, "in_Position");
-	glBindAttribLocation(program, 1, "in_Color");
-
-	glLinkProgram(program);
-	printProgramLog(program);
-
-	glDeleteShader(vertShader);
-	glDeleteShader(fragShader);
-	if (geometryShader != "") {
-		glDeleteShader(geomShader);
-	}
-
-	return program;
-}
-
-
 void glRenderer::generateShaders()
 {
-	shaderSimple = loadShader("data/shader/vertex.shader", "data/shader/fragment.shader", "data/shader/geometry_passthrough.shader");
-	shaderGeometry = loadShader("data/shader/vertex.shader", "data/shader/fragment.shader", "data/shader/geometry_circle.shader");
+	// Linked binaries are cached on disk, so only the first start has to compile from source
+	shaderSimple.cache = &programCache;
+	shaderGeometry.cache = &programCache;
+	// Bind vertex attributes to VBO indices
+	shaderSimple.bindAttribLocation(0, "in_Position");
+	shaderSimple.bindAttribLocation(1, "in_Color");
+	shaderGeometry.bindAttribLocation(0, "in_Position");
+	shaderGeometry.bindAttribLocation(1, "in_Color");
+	// Both programs are compiled in the background, renderScene() uses whichever is ready first
+	shaderSources.addProgram(shaderSimple, { { GL_VERTEX_SHADER, "data/shader/vertex.shader" }, { GL_FRAGMENT_SHADER, "data/shader/fragment.shader" }, { GL_GEOMETRY_SHADER, "data/shader/geometry_passthrough.shader" } }, {}, compileManager);
+	shaderSources.addProgram(shaderGeometry, { { GL_VERTEX_SHADER, "data/shader/vertex.shader" }, { GL_FRAGMENT_SHADER, "data/shader/fragment.shader" }, { GL_GEOMETRY_SHADER, "data/shader/geometry_circle.shader" } }, {}, compileManager);
+	// Edited shader files are recompiled at runtime
+	shaderSources.startWatching();
+	programCache.printStats();
 }
 
 void glRenderer::generateBuffers()
@@ -188,13 +97,25 @@ void glRenderer::renderScene()
 
 	glPolygonMode(GL_FRONT_AND_BACK, (wireframe ? GL_LINE : GL_FILL));
 
-	glUseProgram(useGeometryShader ? shaderGeometry : shaderSimple);
+	compileManager.poll();
+	shaderSources.update(compileManager);
+	ShaderProgram *shader = useGeometryShader ? &shaderGeometry : &shaderSimple;
+	if (!shader->isLinked())
+	{
+		// Fall back to the other program while the selected one is still being compiled
+		shader = useGeometryShader ? &shaderSimple : &shaderGeometry;
+	}
+
+	if (shader->isLinked())
+	{
+		shader->use();
 
-	glUniform1f(glGetUniformLocation(useGeometryShader ? shaderGeometry : shaderSimple, "inRadius"), circleRadius);
-	glUniform1i(glGetUniformLocation(useGeometryShader ? shaderGeometry : shaderSimple, "inNumDivisions"), circleDivisions);
+		shader->setFloat("inRadius", circleRadius);
+		shader->setInt("inNumDivisions", (GLint)circleDivisions);
 
-	glPointSize(16.0f);
-	glDrawArrays(GL_POINTS, 0, 3);
+		glPointSize(16.0f);
+		glDrawArrays(GL_POINTS, 0, 3);
+	}
 
 	glfwSwapBuffers(window);
 }
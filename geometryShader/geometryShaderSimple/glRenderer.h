@@ -8,19 +8,22 @@ This code is licensed under the Mozilla Public License Version 2.0 (http://opens
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "../../base/shaderProgram.hpp"
+#include "../../base/programCache.hpp"
+#include "../../base/shaderCompileManager.hpp"
+
 class glRenderer
 {
 private:
-	GLuint shaderSimple;
-	GLuint shaderGeometry;
+	ShaderProgram shaderSimple;
+	ShaderProgram shaderGeometry;
+	ProgramCache programCache;
+	ShaderCompileManager compileManager;
 	GLuint VBO[2];
 	bool useGeometryShader = true;
 	bool wireframe = true;
 	float circleRadius = 0.3f;
 	float circleDivisions = 4;
-	GLuint loadShader(const char* vertexShaderFile, const char* fragmentShaderFile, const char* geometryShader);
-	void printProgramLog(GLuint shader);
-	void printShaderLog(GLuint program);
 public:
 	GLFWwindow* window;
 	glRenderer();
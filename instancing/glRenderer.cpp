@@ -22,11 +22,13 @@
 #include <array>
 
 #include "glRenderer.h"
+#include "instanceBuffer.hpp"
+#include "transformHierarchy.hpp"
+#include "../base/renderQueue.hpp"
 
 using namespace std;
 
 #define deg_to_rad(deg) deg * float(M_PI / 180)
-#define INSTANCING_RANGE 3
 
 struct UboInstanceData {
 	// Model matrix for each instance
@@ -37,16 +39,63 @@ struct UboInstanceData {
 	glm::vec4 color;
 };
 
+// Compact per instance data (32 bytes instead of 80)
+// Layout matches the std430 Instance struct in mesh_compact.vert
+struct InstanceDataCompact {
+	// xyz = translation, w = uniform scale
+	glm::vec4 positionScale;
+	// Rotation quaternion quantized to 16 bit snorm (x = xy, y = zw)
+	uint32_t rotation[2];
+	// RGBA8 color
+	uint32_t color;
+	uint32_t padding;
+};
+
+// Per instance animation state, advanced on the gpu by instance_animate.comp
+struct InstanceAnimation {
+	// xyz = orbit center, w = orbit radius
+	glm::vec4 origin;
+	// x = angular velocity, y = orbit speed, z = bob amplitude, w = bob frequency (all per second)
+	glm::vec4 params;
+	// x = rotation angle, y = orbit angle, z = bob phase, w = unused
+	glm::vec4 state;
+};
+
 struct {
 	// Global matrices
 	struct {
 		glm::mat4 projection;
 		glm::mat4 view;
+		// Premultiplied for compact instance data
+		glm::mat4 viewProjection;
 	} matrices;
 	// Seperate data for each instance
 } uboVS;
 
-std::array<UboInstanceData, (INSTANCING_RANGE * 2 + 1)*(INSTANCING_RANGE * 2 + 1)*(INSTANCING_RANGE * 2 + 1)> uboInstance;
+InstanceBuffer<UboInstanceData> uboInstance;
+
+// Transform hierarchy for the instance ubo: scene root -> grid layers -> instances
+ThreadPool threadPool;
+TransformHierarchy instanceHierarchy;
+std::vector<uint32_t> layerNodes;
+std::vector<uint32_t> instanceNodes;
+
+RenderQueue renderQueue;
+
+// Parameters for procedural instancing
+// The vertex shader reconstructs model matrix and color from gl_InstanceID
+// using these, so no per instance data is uploaded at all
+struct {
+	// xyz = grid range per axis (instances are placed from -range to +range)
+	glm::ivec4 range;
+	// xyz = distance between two instances, w = rotation around y axis (radians)
+	glm::vec4 spacing;
+	// x = seed for the color hash
+	glm::uvec4 seed;
+} uboProcedural;
+
+InstanceBuffer<InstanceDataCompact> compactInstances;
+std::vector<InstanceAnimation> instanceAnimations;
 
 string readFile(const char *fileName) 
 {
@@ -144,15 +193,183 @@ GLuint glRenderer::loadShader(const char* vertexShaderFile, const char* fragment
 
 	glBindBufferBase(GL_UNIFORM_BUFFER, 0, UBO);
 	glBindBufferBase(GL_UNIFORM_BUFFER, 1, UBOInst);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 2, UBOProcedural);
+
+	glUseProgram(program);
+
+	return program;
+}
+
+GLuint glRenderer::loadSpirvShader(const char* vertexShaderFile, const char* fragmentShaderFile, const SpecializationConstants &vertexConstants)
+{
+	std::vector<uint32_t> vertSpirv, fragSpirv;
+	if (!readSpirvFile(vertexShaderFile, vertSpirv) || !readSpirvFile(fragmentShaderFile, fragSpirv))
+	{
+		return 0;
+	}
+
+	std::cout << "Specializing vertex shader." << std::endl;
+	GLuint vertShader = loadSpirvStage(GL_VERTEX_SHADER, vertSpirv, "main", vertexConstants);
+	std::cout << "Specializing fragment shader." << std::endl;
+	GLuint fragShader = loadSpirvStage(GL_FRAGMENT_SHADER, fragSpirv, "main", SpecializationConstants());
+	if ((vertShader == 0) || (fragShader == 0))
+	{
+		glDeleteShader(vertShader);
+		glDeleteShader(fragShader);
+		return 0;
+	}
+
+	// Attribute locations and block bindings are explicit in the SPIR-V modules
+	std::cout << "Linking program" << std::endl;
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertShader);
+	glAttachShader(program, fragShader);
+	glLinkProgram(program);
+	printProgramLog(program);
+
+	glDeleteShader(vertShader);
+	glDeleteShader(fragShader);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, UBO);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 1, UBOInst);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 2, UBOProcedural);
 
 	glUseProgram(program);
 
 	return program;
 }
 
+GLuint glRenderer::loadComputeShader(const char* computeShaderFile)
+{
+	GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
+
+	// Read shader
+	std::string computeShaderStr = readFile(computeShaderFile);
+	const char *computeShaderSrc = computeShaderStr.c_str();
+
+	std::cout << "Compiling compute shader." << std::endl;
+	glShaderSource(computeShader, 1, &computeShaderSrc, NULL);
+	glCompileShader(computeShader);
+	printShaderLog(computeShader);
+
+	std::cout << "Linking program" << std::endl;
+	GLuint program = glCreateProgram();
+	glAttachShader(program, computeShader);
+	glLinkProgram(program);
+	printProgramLog(program);
+
+	glDeleteShader(computeShader);
+
+	return program;
+}
+
 void glRenderer::generateShaders()
 {
-	shader = loadShader("../data/shader/mesh.vert", "../data/shader/mesh.frag");
+	shaderAnimate = loadComputeShader("../data/shader/instance_animate.comp");
+	shaderProcedural = loadShader("../data/shader/mesh_procedural.vert", "../data/shader/mesh.frag");
+	shaderCompact = loadShader("../data/shader/mesh_compact.vert", "../data/shader/mesh.frag");
+	// The instance array bound and color source are specialization constants of the SPIR-V modules
+	// Falls back to the GLSL sources (and their default bound) if the modules haven't been built
+	shader = 0;
+	if (GLEW_ARB_gl_spirv)
+	{
+		SpecializationConstants constants;
+		constants.set(0, (int32_t)instanceCount);
+		constants.set(1, true);
+		shader = loadSpirvShader("../data/shader/mesh.vert.spv", "../data/shader/mesh.frag.spv", constants);
+	}
+	if (shader == 0)
+	{
+		shader = loadShader("../data/shader/mesh.vert", "../data/shader/mesh.frag");
+	}
+}
+
+void glRenderer::updateProceduralUBO()
+{
+	uboProcedural.range = glm::ivec4(gridRange, gridRange, gridRange, 0);
+	uboProcedural.spacing = glm::vec4(5.0f, 5.0f, 5.0f, deg_to_rad(-45.0f));
+	uboProcedural.seed.x = 0x9e3779b9;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, UBOProcedural);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(uboProcedural), &uboProcedural);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void glRenderer::updateCompactInstances()
+{
+	compactInstances.resize(gridInstanceCount);
+	instanceAnimations.resize(gridInstanceCount);
+
+	// Same grid as the instance ubo, but encoded into 32 bytes per instance
+	float offset = 5.0f;
+	glm::quat rotation = glm::angleAxis(deg_to_rad(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	uint32_t index = 0;
+	for (int32_t x = -gridRange; x <= gridRange; x++)
+	{
+		for (int32_t y = -gridRange; y <= gridRange; y++)
+		{
+			for (int32_t z = -gridRange; z <= gridRange; z++)
+			{
+				InstanceDataCompact &instance = compactInstances.modify(index);
+				instance.positionScale = glm::vec4(x * offset, y * offset, z * offset, 1.0f);
+				instance.rotation[0] = glm::packSnorm2x16(glm::vec2(rotation.x, rotation.y));
+				instance.rotation[1] = glm::packSnorm2x16(glm::vec2(rotation.z, rotation.w));
+				instance.color = glm::packUnorm4x8(glm::vec4(
+					(float)(rand() % 255) / 255.0f,
+					(float)(rand() % 255) / 255.0f,
+					(float)(rand() % 255) / 255.0f,
+					1.0f));
+				instance.padding = 0;
+				// Random animation parameters, the grid position is the orbit center
+				InstanceAnimation &animation = instanceAnimations[index];
+				animation.origin = glm::vec4(x * offset, y * offset, z * offset, (float)(rand() % 100) / 100.0f);
+				animation.params = glm::vec4(
+					(float)(rand() % 200 - 100) / 50.0f,
+					(float)(rand() % 200 - 100) / 50.0f,
+					(float)(rand() % 100) / 100.0f,
+					(float)(rand() % 100) / 25.0f);
+				animation.state = glm::vec4(deg_to_rad(-45.0f), 0.0f, (float)(rand() % 628) / 100.0f, 0.0f);
+				index++;
+			}
+		}
+	}
+
+	compactInstances.upload();
+
+	// Animation state is only uploaded once, after that it's advanced on the gpu
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBOAnimation);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, instanceAnimations.size() * sizeof(InstanceAnimation), instanceAnimations.data(), GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	compactGridRange = gridRange;
+	compactInstancesAnimated = false;
+}
+
+void glRenderer::updateGrid()
+{
+	// Compact instances are limited by the size of their storage buffers
+	if (instanceDataType == INSTANCE_DATA_COMPACT)
+	{
+		gridRange = std::min(gridRange, maxCompactGridRange);
+	}
+	// gridRange is capped to maxGridRange, so the count fits into 32 bits
+	uint64_t gridSize = (uint64_t)gridRange * 2 + 1;
+	gridInstanceCount = (uint32_t)(gridSize * gridSize * gridSize);
+	updateProceduralUBO();
+	// Procedural instances need no instance data at all
+	if (instanceDataType == INSTANCE_DATA_COMPACT)
+	{
+		updateCompactInstances();
+	}
+	std::cout << "instance count = " << gridInstanceCount << std::endl;
 }
 
 void glRenderer::updateUBO()
@@ -170,6 +387,8 @@ void glRenderer::updateUBO()
 	uboVS.matrices.view = glm::rotate(uboVS.matrices.view, deg_to_rad(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
 	uboVS.matrices.view = glm::rotate(uboVS.matrices.view, deg_to_rad(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
+	uboVS.matrices.viewProjection = uboVS.matrices.projection * uboVS.matrices.view;
+
 	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
 	GLvoid* p = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
 	memcpy(p, &uboVS, sizeof(uboVS));
@@ -177,42 +396,112 @@ void glRenderer::updateUBO()
 
 	// Instanced part
 
-	// Colors and model matrices are fixed
+	// Colors are fixed, model matrices come from the transform hierarchy
+	for (uint32_t index = 0; index < uboInstance.size(); index++)
+	{
+		// Instance color (randomized)
+		uboInstance.modify(index).color = glm::vec4(
+			(float)(rand() % 255) / 255.0f, 
+			(float)(rand() % 255) / 255.0f, 
+			(float)(rand() % 255) / 255.0f, 
+			1.0);
+	}
+
+	updateInstanceTransforms(0.0);
+	uboInstance.upload();
+}
+
+void glRenderer::generateHierarchy()
+{
 	float offset = 5.0f;
-	uint32_t index = 0;
+	glm::quat identity = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+	uint32_t root = instanceHierarchy.addNode(-1, glm::vec3(0.0f), identity, glm::vec3(1.0f));
+
+	// One node per grid layer along the y axis
+	for (int32_t y = -INSTANCING_RANGE; y <= INSTANCING_RANGE; y++)
+	{
+		layerNodes.push_back(instanceHierarchy.addNode(root, glm::vec3(0.0f, y * offset, 0.0f), identity, glm::vec3(1.0f)));
+	}
+
+	// Instances are children of their layer, same order as the instance ubo
+	glm::quat rotation = glm::angleAxis(deg_to_rad(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 	for (int32_t x = -INSTANCING_RANGE; x <= INSTANCING_RANGE; x++)
 	{
 		for (int32_t y = -INSTANCING_RANGE; y <= INSTANCING_RANGE; y++)
 		{
 			for (int32_t z = -INSTANCING_RANGE; z <= INSTANCING_RANGE; z++)
 			{
-				// Instance model matrix
-				uboInstance[index].model = glm::translate(glm::mat4(), glm::vec3(x * offset, y * offset, z * offset));
-				uboInstance[index].model = glm::rotate(uboInstance[index].model, deg_to_rad(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-				// Instance color (randomized)
-				uboInstance[index].color = glm::vec4(
-					(float)(rand() % 255) / 255.0f, 
-					(float)(rand() % 255) / 255.0f, 
-					(float)(rand() % 255) / 255.0f, 
-					1.0);
-				index++;
+				instanceNodes.push_back(instanceHierarchy.addNode(layerNodes[y + INSTANCING_RANGE], glm::vec3(x * offset, 0.0f, z * offset), rotation, glm::vec3(1.0f)));
 			}
 		}
 	}
 
-	uint32_t uboSize = uboInstance.size() * sizeof(UboInstanceData);
+	instanceHierarchy.finalize();
+}
 
-	glBindBuffer(GL_UNIFORM_BUFFER, UBOInst);
-	p = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-	memcpy(p, uboInstance.data(), uboSize);
-	glUnmapBuffer(GL_UNIFORM_BUFFER);
+void glRenderer::updateInstanceTransforms(double deltaT)
+{
+	if (animateHierarchy)
+	{
+		// Only every other layer is rotated, so only their subtrees need new world matrices
+		hierarchyTime += (float)deltaT;
+		for (uint32_t i = 0; i < layerNodes.size(); i += 2)
+		{
+			instanceHierarchy.setRotation(layerNodes[i], glm::angleAxis(hierarchyTime * (0.25f + 0.1f * i), glm::vec3(0.0f, 1.0f, 0.0f)));
+		}
+	}
+
+	instanceHierarchy.update(threadPool);
+
+	// Feed changed world matrices into the instance buffer
+	for (uint32_t i = 0; i < instanceNodes.size(); i++)
+	{
+		if (instanceHierarchy.wasUpdated(instanceNodes[i]))
+		{
+			uboInstance.modify(i).model = instanceHierarchy.getWorldMatrix(instanceNodes[i]);
+		}
+	}
+}
 
+void glRenderer::recolorInstances(uint32_t count)
+{
+	// Changes the color of a few random instances, only those are uploaded to the gpu
+	if (instanceDataType == INSTANCE_DATA_MATRIX)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uboInstance.modify(rand() % uboInstance.size()).color = glm::vec4(
+				(float)(rand() % 255) / 255.0f,
+				(float)(rand() % 255) / 255.0f,
+				(float)(rand() % 255) / 255.0f,
+				1.0);
+		}
+	}
+	// Compact instances hold stale positions on the cpu side while they're animated on the gpu
+	if ((instanceDataType == INSTANCE_DATA_COMPACT) && (!animateInstances))
+	{
+		// Fetch the animated positions once, otherwise uploading the new colors would move instances back to the grid
+		if (compactInstancesAnimated)
+		{
+			glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+			compactInstances.download();
+			compactInstancesAnimated = false;
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			compactInstances.modify(rand() % compactInstances.size()).color = glm::packUnorm4x8(glm::vec4(
+				(float)(rand() % 255) / 255.0f,
+				(float)(rand() % 255) / 255.0f,
+				(float)(rand() % 255) / 255.0f,
+				1.0f));
+		}
+	}
 }
 
 void glRenderer::generateBuffers()
 {
 	// Default VAO needed for OpenGL 3.3+ core profiles
-	GLuint VAO;
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 
@@ -285,13 +574,41 @@ void glRenderer::generateBuffers()
 	// Instancing ubo
 	instanceCount = pow((INSTANCING_RANGE * 2) + 1, 3);
 
-	glGenBuffers(1, &UBOInst);
-	glBindBuffer(GL_UNIFORM_BUFFER, UBOInst);
-	glBufferData(GL_UNIFORM_BUFFER, uboInstance.size() * sizeof(UboInstanceData), uboInstance.data(), GL_DYNAMIC_DRAW);
+	uboInstance.create(GL_UNIFORM_BUFFER, instanceCount);
+	UBOInst = uboInstance.getBuffer();
+	generateHierarchy();
+
+	// Procedural instancing ubo
+	glGenBuffers(1, &UBOProcedural);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBOProcedural);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(uboProcedural), &uboProcedural, GL_DYNAMIC_DRAW);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
+	// Compact instance data ssbo
+	compactInstances.create(GL_SHADER_STORAGE_BUFFER, 0);
+	SSBOCompact = compactInstances.getBuffer();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, SSBOCompact);
+
+	// Instance animation state ssbo
+	glGenBuffers(1, &SSBOAnimation);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, SSBOAnimation);
+
+	// The animation records are the largest per instance data of the compact instances
+	GLint64 maxBlockSize = 0;
+	glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+	uint64_t maxCompactInstances = (uint64_t)maxBlockSize / sizeof(InstanceAnimation);
+	while ((uint64_t)(maxCompactGridRange * 2 + 3) * (maxCompactGridRange * 2 + 3) * (maxCompactGridRange * 2 + 3) <= maxCompactInstances)
+	{
+		maxCompactGridRange++;
+	}
+	// Procedural instances store nothing, they're only limited by the (signed) gl_InstanceID
+	while ((uint64_t)(maxGridRange * 2 + 3) * (maxGridRange * 2 + 3) * (maxGridRange * 2 + 3) <= (uint64_t)INT32_MAX)
+	{
+		maxGridRange++;
+	}
 
 	updateUBO();
+	updateGrid();
 
 	delete(demoMesh);
 
@@ -300,20 +617,65 @@ void glRenderer::generateBuffers()
 
 }
 
-void glRenderer::renderScene()
+void glRenderer::renderScene(double deltaT)
 {
 	double frameTimeStart = glfwGetTime();
 
+	if (recolor)
+	{
+		recolorInstances(recolorCount);
+	}
+	if (instanceDataType == INSTANCE_DATA_MATRIX)
+	{
+		updateInstanceTransforms(deltaT);
+	}
+
+	// Only changed instances are transferred to the gpu
+	uboInstance.upload();
+	compactInstances.upload();
+	instanceUploadBytes = uboInstance.stats.bytesUploaded + compactInstances.stats.bytesUploaded;
+
+	// Advance instance animation on the gpu, no instance data is touched by the cpu
+	if ((animateInstances) && (instanceDataType == INSTANCE_DATA_COMPACT))
+	{
+		glUseProgram(shaderAnimate);
+		// Explicit uniform locations from instance_animate.comp
+		glUniform1f(0, (float)deltaT);
+		glUniform1ui(1, gridInstanceCount);
+		glDispatchCompute((gridInstanceCount + 255) / 256, 1, 1);
+		compactInstancesAnimated = true;
+		// Make sure the instance data has been written before it's read by the vertex shader
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glDrawElementsInstanced(
-		GL_TRIANGLES,
-		indices,
-		GL_UNSIGNED_INT,
-		(void*)0,
-		instanceCount
-		);
+	// Draws are submitted to the render queue, which sorts them and only changes state where required
+	RenderPacket packet;
+	packet.vertexArray = VAO;
+	packet.indexCount = indices;
+	if (instanceDataType == INSTANCE_DATA_PROCEDURAL)
+	{
+		// No instance buffer is read, everything is derived from gl_InstanceID
+		packet.program = shaderProcedural;
+		packet.instanceCount = gridInstanceCount;
+	}
+	else if (instanceDataType == INSTANCE_DATA_COMPACT)
+	{
+		packet.program = shaderCompact;
+		packet.instanceCount = gridInstanceCount;
+	}
+	else
+	{
+		packet.program = shader;
+		packet.instanceCount = instanceCount;
+	}
+	// The instanced grid is centered at the origin, so there's no meaningful depth to sort by
+	packet.key = RenderQueue::makeKey(RENDER_PASS_OPAQUE, packet.program, 0, 0.0f);
+	renderQueue.submit(packet);
+
+	renderQueue.execute();
 
 	glfwSwapBuffers(window);
 }
@@ -322,12 +684,31 @@ void glRenderer::keyCallback(int key, int scancode, int action, int mods)
 {
 	if (key == GLFW_KEY_W && action == GLFW_PRESS)
 		wireframe = !wireframe;
-	if (key == GLFW_KEY_KP_ADD && action == GLFW_PRESS && mods != GLFW_MOD_SHIFT && circleDivisions < 85)
-		circleDivisions += 1;
-	if (key == GLFW_KEY_KP_SUBTRACT && action == GLFW_PRESS && mods != GLFW_MOD_SHIFT && circleDivisions > 3)
-		circleDivisions -= 1;
-	if (key == GLFW_KEY_KP_ADD && action == GLFW_PRESS && mods == GLFW_MOD_SHIFT)
-		circleRadius += 0.025f;
-	if (key == GLFW_KEY_KP_SUBTRACT && action == GLFW_PRESS && mods == GLFW_MOD_SHIFT && circleRadius >= 0.1f)
-		circleRadius -= 0.025f;
+	if (key == GLFW_KEY_A && action == GLFW_PRESS)
+		animateInstances = !animateInstances;
+	if (key == GLFW_KEY_R && action == GLFW_PRESS)
+		recolor = !recolor;
+	if (key == GLFW_KEY_H && action == GLFW_PRESS)
+		animateHierarchy = !animateHierarchy;
+	if (key == GLFW_KEY_I && action == GLFW_PRESS)
+	{
+		instanceDataType = (instanceDataType + 1) % 3;
+		std::cout << "instanceDataType = " << instanceDataType << std::endl;
+		// Compact instance data is built on demand for the current grid, which may have to shrink to fit
+		if ((instanceDataType == INSTANCE_DATA_COMPACT) && ((compactGridRange != gridRange) || (gridRange > maxCompactGridRange)))
+		{
+			updateGrid();
+		}
+	}
+	// Grid size can't be changed for the instance ubo, it has a fixed size
+	if (key == GLFW_KEY_KP_ADD && action == GLFW_PRESS && instanceDataType != INSTANCE_DATA_MATRIX)
+	{
+		gridRange = std::min(gridRange + ((mods == GLFW_MOD_SHIFT) ? 10 : 1), (instanceDataType == INSTANCE_DATA_COMPACT) ? maxCompactGridRange : maxGridRange);
+		updateGrid();
+	}
+	if (key == GLFW_KEY_KP_SUBTRACT && action == GLFW_PRESS && instanceDataType != INSTANCE_DATA_MATRIX && gridRange > 0)
+	{
+		gridRange = std::max(gridRange - ((mods == GLFW_MOD_SHIFT) ? 10 : 1), 0);
+		updateGrid();
+	}
 }
@@ -14,34 +14,85 @@
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "meshLoader.hpp"
+#include "../base/spirvShader.hpp"
+
+// Default grid range, instances are placed from -range to +range on each axis
+#define INSTANCING_RANGE 3
+
+// Source of the per instance data
+// Model matrices and colors are read from an instance uniform buffer
+#define INSTANCE_DATA_MATRIX 0
+// Compact instance data (position, quantized quaternion, scale, RGBA8 color) is read from a shader storage buffer
+#define INSTANCE_DATA_COMPACT 1
+// Model matrices and colors are reconstructed in the vertex shader from gl_InstanceID
+#define INSTANCE_DATA_PROCEDURAL 2
+
+// Render queue passes, lower passes are drawn first
+#define RENDER_PASS_OPAQUE 0
+#define RENDER_PASS_TRANSPARENT 1
 
 class glRenderer
 {
 private:
 	GLuint shader;
+	GLuint shaderCompact;
+	GLuint shaderProcedural;
+	GLuint shaderAnimate;
+	GLuint VAO;
 	GLuint VBO[2];
 	GLuint IBO;
-	GLuint UBO, UBOInst;
+	GLuint UBO, UBOInst, UBOProcedural;
+	GLuint SSBOCompact, SSBOAnimation;
 	uint32_t indices;
+	uint32_t instanceDataType = INSTANCE_DATA_MATRIX;
+	// Grid range and instance count for compact and procedural instance data
+	int32_t gridRange = INSTANCING_RANGE;
+	uint32_t gridInstanceCount;
+	// Largest range whose instance count still fits into gl_InstanceID (procedural instances)
+	int32_t maxGridRange = INSTANCING_RANGE;
+	// Largest range whose animation records still fit into a single shader storage block (compact instances)
+	int32_t maxCompactGridRange = INSTANCING_RANGE;
+	// Range the compact instance data was built for, it's only built while (or when switching to) compact mode
+	int32_t compactGridRange = -1;
+	// Set once the gpu animated the compact instances, the cpu side copy is stale until read back
+	bool compactInstancesAnimated = false;
+	bool animateInstances = false;
+	// Randomly recolor a few instances each frame to test partial instance buffer updates
+	bool recolor = false;
+	uint32_t recolorCount = 16;
+	void recolorInstances(uint32_t count);
+	// Rotate grid layers through the transform hierarchy
+	bool animateHierarchy = false;
+	float hierarchyTime = 0.0f;
+	void generateHierarchy();
+	void updateInstanceTransforms(double deltaT);
+	void updateProceduralUBO();
+	void updateCompactInstances();
+	void updateGrid();
 	bool useGeometryShader = true;
 	bool wireframe = true;
 	float circleRadius = 0.3f;
 	float circleDivisions = 2;
 	GLuint loadShader(const char* vertexShaderFile, const char* fragmentShaderFile);
+	GLuint loadSpirvShader(const char* vertexShaderFile, const char* fragmentShaderFile, const SpecializationConstants &vertexConstants);
+	GLuint loadComputeShader(const char* computeShaderFile);
 	void printProgramLog(GLuint shader);
 	void printShaderLog(GLuint program);
 	MeshLoader *demoMesh;
 	uint32_t instanceCount;
 public:
 	GLFWwindow* window;
+	// Instance data bytes transferred to the gpu in the last frame
+	uint64_t instanceUploadBytes = 0;
 	glRenderer();
 	~glRenderer();
 	void generateShaders();
 	void updateUBO();
 	void generateBuffers();
-	void renderScene();
+	void renderScene(double deltaT);
 	void keyCallback(int key, int scancode, int action, int mods);
 };
 
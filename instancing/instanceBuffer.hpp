@@ -0,0 +1,225 @@
+/*
+* Instance data store with dirty tracking for partial buffer updates
+*
+* Copyright (C) 2015 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <GL/glew.h>
+
+// Keeps a cpu side copy of the instance data and tracks changed instances in a bitset
+// On upload, dirty instances are coalesced into ranges and only those are transferred
+// If too many instances changed, the whole buffer is uploaded at once instead
+template <typename T>
+class InstanceBuffer
+{
+private:
+	std::vector<T> instances;
+	// One bit per instance, set if the instance changed since the last upload
+	std::vector<uint64_t> dirtyBits;
+	uint32_t dirtyCount = 0;
+	GLuint buffer = 0;
+	GLenum target = GL_UNIFORM_BUFFER;
+	// Size of the buffer's data store in bytes
+	GLsizeiptr bufferSize = 0;
+
+	static uint32_t bitScanForward(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#else
+		return __builtin_ctzll(value);
+#endif
+	}
+
+	void uploadRange(uint32_t first, uint32_t count)
+	{
+		GLintptr offset = first * sizeof(T);
+		GLsizeiptr size = count * sizeof(T);
+		if (useMapRange)
+		{
+			// Only the mapped range is invalidated, the driver doesn't need to preserve its contents
+			void *p = glMapBufferRange(target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+			memcpy(p, &instances[first], size);
+			glUnmapBuffer(target);
+		}
+		else
+		{
+			glBufferSubData(target, offset, size, &instances[first]);
+		}
+		stats.bytesUploaded += size;
+		stats.rangesUploaded++;
+		stats.instancesUploaded += count;
+	}
+
+public:
+	// Upload statistics for the last call to upload()
+	struct Stats
+	{
+		uint64_t bytesUploaded = 0;
+		uint32_t rangesUploaded = 0;
+		uint32_t instancesUploaded = 0;
+		bool fullUpload = false;
+	} stats;
+
+	// Fraction of dirty instances above which the whole buffer is uploaded
+	float fullUploadThreshold = 0.25f;
+	// Number of clean instances allowed between two dirty ones to still merge them into one range
+	uint32_t mergeGap = 4;
+	// Use glMapBufferRange with GL_MAP_INVALIDATE_RANGE_BIT for partial updates instead of glBufferSubData
+	bool useMapRange = true;
+
+	void create(GLenum target, uint32_t count)
+	{
+		this->target = target;
+		glGenBuffers(1, &buffer);
+		resize(count);
+	}
+
+	// Resizing marks all instances as dirty, the data store is reallocated on the next upload
+	void resize(uint32_t count)
+	{
+		instances.resize(count);
+		dirtyBits.assign((count + 63) / 64, 0);
+		markAllDirty();
+	}
+
+	uint32_t size() const
+	{
+		return static_cast<uint32_t>(instances.size());
+	}
+
+	GLuint getBuffer() const
+	{
+		return buffer;
+	}
+
+	const T& operator[](uint32_t index) const
+	{
+		return instances[index];
+	}
+
+	// Returns a writable reference and flags the instance as dirty
+	T& modify(uint32_t index)
+	{
+		markDirty(index);
+		return instances[index];
+	}
+
+	void set(uint32_t index, const T& value)
+	{
+		modify(index) = value;
+	}
+
+	void markDirty(uint32_t index)
+	{
+		uint64_t bit = 1ull << (index & 63);
+		if (!(dirtyBits[index >> 6] & bit))
+		{
+			dirtyBits[index >> 6] |= bit;
+			dirtyCount++;
+		}
+	}
+
+	void markAllDirty()
+	{
+		std::fill(dirtyBits.begin(), dirtyBits.end(), ~0ull);
+		// Clear the bits past the last instance
+		if (instances.size() & 63)
+		{
+			dirtyBits.back() = (1ull << (instances.size() & 63)) - 1;
+		}
+		dirtyCount = size();
+	}
+
+	uint32_t getDirtyCount() const
+	{
+		return dirtyCount;
+	}
+
+	// Transfers all dirty instances to the gpu buffer
+	void upload()
+	{
+		stats = Stats();
+		if (dirtyCount == 0)
+		{
+			return;
+		}
+
+		glBindBuffer(target, buffer);
+
+		GLsizeiptr requiredSize = instances.size() * sizeof(T);
+		if ((requiredSize != bufferSize) || (dirtyCount > fullUploadThreshold * instances.size()))
+		{
+			// Full upload, respecifying the data store lets the driver orphan the old one
+			glBufferData(target, requiredSize, instances.data(), GL_DYNAMIC_DRAW);
+			bufferSize = requiredSize;
+			stats.bytesUploaded = requiredSize;
+			stats.rangesUploaded = 1;
+			stats.instancesUploaded = size();
+			stats.fullUpload = true;
+		}
+		else
+		{
+			// Walk the set bits and coalesce them into ranges
+			int64_t rangeStart = -1;
+			uint32_t rangeEnd = 0;
+			for (uint32_t word = 0; word < dirtyBits.size(); word++)
+			{
+				uint64_t bits = dirtyBits[word];
+				while (bits != 0)
+				{
+					uint32_t index = word * 64 + bitScanForward(bits);
+					bits &= bits - 1;
+					if ((rangeStart >= 0) && (index - rangeEnd <= mergeGap))
+					{
+						rangeEnd = index + 1;
+						continue;
+					}
+					if (rangeStart >= 0)
+					{
+						uploadRange(static_cast<uint32_t>(rangeStart), rangeEnd - static_cast<uint32_t>(rangeStart));
+					}
+					rangeStart = index;
+					rangeEnd = index + 1;
+				}
+			}
+			if (rangeStart >= 0)
+			{
+				uploadRange(static_cast<uint32_t>(rangeStart), rangeEnd - static_cast<uint32_t>(rangeStart));
+			}
+		}
+
+		std::fill(dirtyBits.begin(), dirtyBits.end(), 0ull);
+		dirtyCount = 0;
+
+		glBindBuffer(target, 0);
+	}
+
+	// Reads the buffer back into the cpu side copy, for when the gpu has written to it
+	// Pending changes are uploaded first so they're not lost
+	void download()
+	{
+		upload();
+		if (bufferSize != static_cast<GLsizeiptr>(instances.size() * sizeof(T)))
+		{
+			return;
+		}
+		glBindBuffer(target, buffer);
+		glGetBufferSubData(target, 0, bufferSize, instances.data());
+		glBindBuffer(target, 0);
+	}
+};
@@ -107,14 +107,17 @@ int main(void)
 	glDisable(GL_CULL_FACE);
 
 	printf("\nKeys:\n");
-	printf("""g"" : Toggle geometry shader\n");
-	printf("""w"" : Toggle wireframe\n");
-	printf("""+"" : increase number of subdivisions\n");
-	printf("""-"" : decrease number of subdivisions\n");
-	printf("""shift +"" : increase radius\n");
-	printf("""shift -"" : decrease radius\n");
+	printf("""i"" : Toggle instance data (matrix, compact, procedural)\n");
+	printf("""+"" : increase grid size (compact and procedural instance data)\n");
+	printf("""-"" : decrease grid size (compact and procedural instance data)\n");
+	printf("""shift +"" : increase grid size by 10\n");
+	printf("""shift -"" : decrease grid size by 10\n");
+	printf("""a"" : Toggle gpu instance animation (compact instance data)\n");
+	printf("""r"" : Toggle random recoloring of instances (partial buffer updates)\n");
+	printf("""h"" : Toggle layer rotation through the transform hierarchy (matrix instance data)\n");
 
 	double lastFPStime = glfwGetTime();
+	double lastFrameTime = glfwGetTime();
 	int frameCounter = 0;
 
 	//Main Loop
@@ -130,14 +133,18 @@ int main(void)
 
 			std::string windowTitle = appTitle +" (";
 			windowTitle += std::to_string(frameCounter);
-			windowTitle += " fps) - 2015 by Sascha Willems (www.saschawillems.de)";
+			windowTitle += " fps, ";
+			windowTitle += std::to_string(renderer.instanceUploadBytes);
+			windowTitle += " instance bytes uploaded per frame) - 2015 by Sascha Willems (www.saschawillems.de)";
 			const char* windowCaption = windowTitle.c_str();
 			glfwSetWindowTitle(window, windowCaption);
 
 			frameCounter = 0;
 		}
 
-		renderer.renderScene();
+		double currTime = glfwGetTime();
+		renderer.renderScene(currTime - lastFrameTime);
+		lastFrameTime = currTime;
 
 		//Get and organize events, like keyboard and mouse input, window resizing, etc...
 		glfwPollEvents();
@@ -0,0 +1,189 @@
+/*
+* Flat transform hierarchy with dirty propagation and level by level parallel updates
+*
+* Copyright (C) 2015 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "../base/threadPool.hpp"
+
+// Local transforms are stored as structure of arrays (translation, rotation, scale)
+// Nodes are sorted by their depth, so all parents are stored before their children and
+// each level can be updated in parallel once the previous level is done
+// Only nodes that were changed (and their subtrees) get their world matrix recalculated
+class TransformHierarchy
+{
+private:
+	// Depth and parent handle of each node as passed to addNode, used for sorting in finalize()
+	std::vector<uint32_t> nodeDepths;
+	std::vector<int32_t> nodeParents;
+	// Maps node handles to their position in the sorted arrays
+	std::vector<uint32_t> handleToIndex;
+
+	std::vector<glm::vec3> translations;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	// Parent index (in sorted order) of each node, -1 for root nodes
+	std::vector<int32_t> parents;
+	std::vector<glm::mat4> worldMatrices;
+	// Set by the setters, consumed by update()
+	std::vector<uint8_t> dirty;
+	// Set by update() for all nodes whose world matrix changed
+	std::vector<uint8_t> updated;
+	// First node of each level, with one additional entry for the end of the last level
+	std::vector<uint32_t> levelOffsets;
+
+	glm::mat4 localMatrix(uint32_t index) const
+	{
+		glm::mat4 m = glm::mat4_cast(rotations[index]);
+		m[0] = m[0] * scales[index].x;
+		m[1] = m[1] * scales[index].y;
+		m[2] = m[2] * scales[index].z;
+		m[3] = glm::vec4(translations[index], 1.0f);
+		return m;
+	}
+
+public:
+	// Smallest number of nodes per thread pool job, larger levels are split evenly across all threads
+	uint32_t minGrainSize = 32;
+
+	// Adds a node, the parent has to be added before its children (-1 = root)
+	// Returns a handle that stays valid after finalize()
+	uint32_t addNode(int32_t parent, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+	{
+		uint32_t handle = static_cast<uint32_t>(nodeParents.size());
+		nodeParents.push_back(parent);
+		nodeDepths.push_back((parent < 0) ? 0 : nodeDepths[parent] + 1);
+		translations.push_back(translation);
+		rotations.push_back(rotation);
+		scales.push_back(scale);
+		return handle;
+	}
+
+	// Sorts all nodes by depth (stable, so siblings keep their order) and builds the level table
+	void finalize()
+	{
+		uint32_t nodeCount = static_cast<uint32_t>(nodeParents.size());
+		uint32_t levelCount = nodeCount > 0 ? *std::max_element(nodeDepths.begin(), nodeDepths.end()) + 1 : 0;
+
+		// Counting sort by depth
+		levelOffsets.assign(levelCount + 1, 0);
+		for (uint32_t depth : nodeDepths)
+		{
+			levelOffsets[depth + 1]++;
+		}
+		for (uint32_t i = 1; i <= levelCount; i++)
+		{
+			levelOffsets[i] += levelOffsets[i - 1];
+		}
+		std::vector<uint32_t> levelFill(levelOffsets.begin(), levelOffsets.end() - (levelCount > 0 ? 1 : 0));
+		handleToIndex.resize(nodeCount);
+		for (uint32_t handle = 0; handle < nodeCount; handle++)
+		{
+			handleToIndex[handle] = levelFill[nodeDepths[handle]]++;
+		}
+
+		// Reorder local transforms and remap parents
+		std::vector<glm::vec3> sortedTranslations(nodeCount);
+		std::vector<glm::quat> sortedRotations(nodeCount);
+		std::vector<glm::vec3> sortedScales(nodeCount);
+		parents.resize(nodeCount);
+		for (uint32_t handle = 0; handle < nodeCount; handle++)
+		{
+			uint32_t index = handleToIndex[handle];
+			sortedTranslations[index] = translations[handle];
+			sortedRotations[index] = rotations[handle];
+			sortedScales[index] = scales[handle];
+			parents[index] = (nodeParents[handle] < 0) ? -1 : static_cast<int32_t>(handleToIndex[nodeParents[handle]]);
+		}
+		translations.swap(sortedTranslations);
+		rotations.swap(sortedRotations);
+		scales.swap(sortedScales);
+
+		worldMatrices.resize(nodeCount);
+		dirty.assign(nodeCount, 1);
+		updated.assign(nodeCount, 0);
+	}
+
+	uint32_t size() const
+	{
+		return static_cast<uint32_t>(parents.size());
+	}
+
+	void setTranslation(uint32_t handle, const glm::vec3 &translation)
+	{
+		uint32_t index = handleToIndex[handle];
+		translations[index] = translation;
+		dirty[index] = 1;
+	}
+
+	void setRotation(uint32_t handle, const glm::quat &rotation)
+	{
+		uint32_t index = handleToIndex[handle];
+		rotations[index] = rotation;
+		dirty[index] = 1;
+	}
+
+	void setScale(uint32_t handle, const glm::vec3 &scale)
+	{
+		uint32_t index = handleToIndex[handle];
+		scales[index] = scale;
+		dirty[index] = 1;
+	}
+
+	const glm::mat4& getWorldMatrix(uint32_t handle) const
+	{
+		return worldMatrices[handleToIndex[handle]];
+	}
+
+	// True if the world matrix of the node was recalculated in the last update
+	bool wasUpdated(uint32_t handle) const
+	{
+		return updated[handleToIndex[handle]] != 0;
+	}
+
+	// Recalculates world matrices of all dirty nodes and their subtrees
+	// Returns the number of updated nodes
+	uint32_t update(ThreadPool &threadPool)
+	{
+		std::atomic<uint32_t> updateCount(0);
+		for (uint32_t level = 0; level + 1 < levelOffsets.size(); level++)
+		{
+			uint32_t first = levelOffsets[level];
+			uint32_t count = levelOffsets[level + 1] - first;
+			uint32_t threadCount = threadPool.getThreadCount();
+			uint32_t grainSize = std::max((count + threadCount - 1) / threadCount, minGrainSize);
+			threadPool.parallelFor(count, grainSize, [&](uint32_t begin, uint32_t end)
+			{
+				uint32_t localCount = 0;
+				for (uint32_t i = first + begin; i < first + end; i++)
+				{
+					// The parent's level has already been processed, so its flag is final
+					int32_t parent = parents[i];
+					bool changed = (dirty[i] != 0) || ((parent >= 0) && (updated[parent] != 0));
+					updated[i] = changed ? 1 : 0;
+					dirty[i] = 0;
+					if (changed)
+					{
+						worldMatrices[i] = (parent >= 0) ? worldMatrices[parent] * localMatrix(i) : localMatrix(i);
+						localCount++;
+					}
+				}
+				updateCount += localCount;
+			});
+		}
+		return updateCount;
+	}
+};
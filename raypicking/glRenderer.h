@@ -17,6 +17,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "../base/streamingBuffer.hpp"
+
 #define PICKING_TYPE_PROJECT 0
 #define PICKING_TYPE_UNPROJECT 1
 
@@ -39,6 +41,8 @@ private:
 public:
 	bool paused = false;
 	GLFWwindow* window;
+	// Persistently mapped ring buffer for the ubo, if buffer storage is supported
+	StreamingBuffer uniformStream;
 	glRenderer();
 	~glRenderer();
 	void generateShaders();
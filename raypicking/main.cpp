@@ -130,7 +130,9 @@ int main(void)
 
 			std::string windowTitle = appTitle +" (";
 			windowTitle += std::to_string(frameCounter);
-			windowTitle += " fps) - 2016 by Sascha Willems (www.saschawillems.de)";
+			windowTitle += " fps, ";
+			windowTitle += std::to_string(renderer.uniformStream.stats.fenceWaits);
+			windowTitle += " ubo fence waits) - 2016 by Sascha Willems (www.saschawillems.de)";
 			const char* windowCaption = windowTitle.c_str();
 			glfwSetWindowTitle(window, windowCaption);
 
@@ -148,6 +150,9 @@ int main(void)
 	} //Check if the ESC key had been pressed or if the window had been closed
 	while (!glfwWindowShouldClose(window));
 
+	// Unmap the persistently mapped ubo ring buffer and release its fences while the context is still current
+	renderer.uniformStream.destroy();
+
 	//Close OpenGL window and terminate GLFW
 	glfwDestroyWindow(window);
 	//Finalize and clean up GLFW
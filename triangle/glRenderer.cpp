@@ -125,7 +125,11 @@ GLuint glRenderer::loadShader(const char* vertexShaderFile, const char* fragment
 	glDeleteShader(vertShader);
 	glDeleteShader(fragShader);
 
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, UBO);
+	// The streaming buffer binds a range on each update instead
+	if (!uniformStream.isCreated())
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, 0, UBO);
+	}
 
 	glUseProgram(program);
 
@@ -151,6 +155,15 @@ void glRenderer::updateUBO()
 	uboVS.model = glm::rotate(uboVS.model, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
 
+	if (uniformStream.isCreated())
+	{
+		// Write into this frame's region of the persistently mapped buffer, no sync with the gpu required
+		StreamingBuffer::Allocation allocation = uniformStream.allocate(sizeof(uboVS));
+		memcpy(allocation.pointer, &uboVS, sizeof(uboVS));
+		uniformStream.bindRange(0, allocation);
+		return;
+	}
+
 	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
 	GLvoid* p = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
 	memcpy(p, &uboVS, sizeof(uboVS));
@@ -202,10 +215,19 @@ void glRenderer::generateBuffers()
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, iBufferSize, indexBuffer.data(), GL_STATIC_DRAW);
 
 	// Uniform buffer object
-	glGenBuffers(1, &UBO);
-	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(uboVS), &uboVS, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	if (StreamingBuffer::isSupported())
+	{
+		// Ring buffer with one region per frame in flight, each region can hold several ubo updates
+		uniformStream.create(GL_UNIFORM_BUFFER, 4 * sizeof(uboVS), 3);
+		UBO = uniformStream.getBuffer();
+	}
+	else
+	{
+		glGenBuffers(1, &UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(uboVS), &uboVS, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
 
 	updateUBO();
 
@@ -224,6 +246,12 @@ void glRenderer::renderScene(double deltaT)
 
 	glfwSwapBuffers(window);
 
+	// All commands reading this frame's uniforms have been submitted
+	if (uniformStream.isCreated())
+	{
+		uniformStream.nextFrame();
+	}
+
 	rotation.y += deltaT * 50.0f;
 	updateUBO();
 }
@@ -15,6 +15,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "../base/streamingBuffer.hpp"
+
 class glRenderer
 {
 private:
@@ -31,6 +33,8 @@ private:
 	uint32_t instanceCount;
 public:
 	GLFWwindow* window;
+	// Persistently mapped ring buffer for the ubo, if buffer storage is supported
+	StreamingBuffer uniformStream;
 	glRenderer();
 	~glRenderer();
 	void generateShaders();